@@ -0,0 +1,258 @@
+/****************************************************************************
+ * bench.c
+ *
+ * CC 50
+ * Pset 4
+ *
+ * Benchmarks the solver engines over every board of the level files.
+***************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "includes/puzzle.h"
+#include "includes/store.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// latency histogram's buckets: [0, 1us), [1, 2us), [2, 4us), ... (log2)
+#define BUCKETS 24
+
+// results of one engine over one file
+typedef struct {
+    const char *engine;
+    const char *file;
+    int boards;
+    int reps;
+    int failed;
+    double total_us;
+    double min_us, median_us, p99_us, max_us;
+    double calls, guesses;
+    long max_guesses;
+    long histogram[BUCKETS];
+} result;
+
+
+/*
+ * Returns true iff board is completely and correctly filled and agrees with givens
+*/
+
+static int verify(int board[N][N], int givens[N][N]) {
+    for(int i = 0; i < N; i++) {
+        long row = 0, col = 0, square = 0;
+        for(int k = 0; k < N; k++) {
+            if(board[i][k] < 1 || board[i][k] > N || board[k][i] < 1 || board[k][i] > N) {
+                return 0;
+            }
+            row |= 1L << board[i][k];
+            col |= 1L << board[k][i];
+            square |= 1L << board[(i / BOX) * BOX + k / BOX][(i % BOX) * BOX + k % BOX];
+            if(givens[i][k] != 0 && givens[i][k] != board[i][k]) {
+                return 0;
+            }
+        }
+        long all = (1L << (N + 1)) - 2;
+        if(row != all || col != all || square != all) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int compare(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double now_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+/*
+ * Runs engine e over every board of s reps times
+*/
+
+static int run(int e, const char *file, const store *s, int reps, result *r) {
+    int count = s->count;
+    double *samples = malloc((size_t) count * reps * sizeof(double));
+    if(samples == NULL) {
+        return 0;
+    }
+
+    memset(r, 0, sizeof(result));
+    r->engine = engineName(e);
+    r->file = file;
+    r->boards = count;
+    r->reps = reps;
+
+    long calls = 0, guesses = 0;
+    for(int rep = 0; rep < reps; rep++) {
+        for(int n = 1; n <= count; n++) {
+            int givens[N][N], board[N][N];
+            store_read(s, n, givens);
+            memcpy(board, givens, sizeof(board));
+
+            solve_stats stats = { 0, 0 };
+            double start = now_us();
+            int solved = solveWith(e, board, &stats);
+            double us = now_us() - start;
+
+            samples[(size_t) rep * count + n - 1] = us;
+            r->total_us += us;
+
+            int bucket = 0;
+            while(bucket < BUCKETS - 1 && us >= (double) (1L << bucket)) {
+                bucket++;
+            }
+            r->histogram[bucket]++;
+
+            // counters and correctness are the same on every repetition
+            if(rep == 0) {
+                calls += stats.calls;
+                guesses += stats.guesses;
+                if(stats.guesses > r->max_guesses) {
+                    r->max_guesses = stats.guesses;
+                }
+                if(!solved || !verify(board, givens)) {
+                    r->failed++;
+                }
+            }
+        }
+    }
+
+    size_t total = (size_t) count * reps;
+    qsort(samples, total, sizeof(double), compare);
+    r->min_us = samples[0];
+    r->median_us = samples[total / 2];
+    r->p99_us = samples[(total * 99) / 100];
+    r->max_us = samples[total - 1];
+    r->calls = (double) calls / count;
+    r->guesses = (double) guesses / count;
+
+    free(samples);
+    return 1;
+}
+
+static void print_human(const result *r) {
+    printf("%-10s %-10s %6d boards x %d  %10.0f boards/s  failed %d\n",
+           r->engine, r->file, r->boards, r->reps, r->boards * r->reps / (r->total_us / 1e6), r->failed);
+    printf("    latency us: min %.2f  median %.2f  p99 %.2f  max %.2f\n",
+           r->min_us, r->median_us, r->p99_us, r->max_us);
+    printf("    per board: %.1f calls, %.1f guesses (max %ld)\n", r->calls, r->guesses, r->max_guesses);
+
+    // only the buckets between the fastest and slowest boards
+    long most = 1;
+    int first = -1, last = 0;
+    for(int b = 0; b < BUCKETS; b++) {
+        if(r->histogram[b] > most) {
+            most = r->histogram[b];
+        }
+        if(r->histogram[b] > 0) {
+            first = (first < 0) ? b : first;
+            last = b;
+        }
+    }
+    for(int b = (first < 0) ? 0 : first; b <= last; b++) {
+        char bar[41];
+        int len = (int) (r->histogram[b] * 40 / most);
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        printf("    < %8ld us %8ld %s\n", 1L << b, r->histogram[b], bar);
+    }
+    printf("\n");
+}
+
+static void print_json(FILE *fp, const result *results, int n) {
+    fprintf(fp, "[\n");
+    for(int i = 0; i < n; i++) {
+        const result *r = &results[i];
+        fprintf(fp, "  {\"engine\": \"%s\", \"file\": \"%s\", \"boards\": %d, \"reps\": %d, \"failed\": %d, "
+                    "\"boards_per_sec\": %.1f, \"min_us\": %.3f, \"median_us\": %.3f, \"p99_us\": %.3f, "
+                    "\"max_us\": %.3f, \"calls_per_board\": %.2f, \"guesses_per_board\": %.2f, "
+                    "\"max_guesses\": %ld, \"histogram_log2_us\": [",
+                r->engine, r->file, r->boards, r->reps, r->failed, r->boards * r->reps / (r->total_us / 1e6),
+                r->min_us, r->median_us, r->p99_us, r->max_us, r->calls, r->guesses, r->max_guesses);
+        for(int b = 0; b < BUCKETS; b++) {
+            fprintf(fp, "%s%ld", b ? ", " : "", r->histogram[b]);
+        }
+        fprintf(fp, "]}%s\n", (i < n - 1) ? "," : "");
+    }
+    fprintf(fp, "]\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: sudoku-bench [-r reps] [-e engine] [-o out.json] [file.bin ...]\n";
+
+    int reps = 3;
+    const char *only = NULL;
+    const char *out = NULL;
+
+    int opt;
+    while((opt = getopt(argc, argv, "r:e:o:")) != -1) {
+        switch(opt) {
+            case 'r':
+                reps = atoi(optarg);
+                break;
+            case 'e':
+                only = optarg;
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            default:
+                fprintf(stderr, usage);
+                return 1;
+        }
+    }
+    if(reps < 1) {
+        fprintf(stderr, usage);
+        return 1;
+    }
+
+    // default to every level
+    char *levels[] = { "debug" SIZE ".bin", "n00b" SIZE ".bin", "l33t" SIZE ".bin" };
+    char **files = (optind < argc) ? argv + optind : levels;
+    int nfiles = (optind < argc) ? argc - optind : 3;
+
+    result *results = calloc((size_t) nfiles * ENGINES, sizeof(result));
+    int n = 0;
+    int failed = 0;
+
+    for(int f = 0; f < nfiles; f++) {
+        store s;
+        if(!store_open(&s, files[f])) {
+            fprintf(stderr, "Could not read boards from %s!\n", files[f]);
+            return 2;
+        }
+        for(int e = 0; e < ENGINES; e++) {
+            if(only != NULL && strcmp(only, engineName(e)) != 0) {
+                continue;
+            }
+            if(run(e, files[f], &s, reps, &results[n])) {
+                print_human(&results[n]);
+                failed += results[n].failed;
+                n++;
+            }
+        }
+        store_close(&s);
+    }
+
+    if(out != NULL) {
+        FILE *fp = fopen(out, "w");
+        if(fp == NULL) {
+            fprintf(stderr, "Could not write %s!\n", out);
+            return 3;
+        }
+        print_json(fp, results, n);
+        fclose(fp);
+    }
+
+    free(results);
+    return failed ? 4 : 0;
+}
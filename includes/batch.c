@@ -0,0 +1,543 @@
+/*
+ * Headless batch modes over *.bin files
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "movelog.h"
+#include "pool.h"
+#include "puzzle.h"
+#include "store.h"
+#include "sudoku.h"
+
+// boards handed to a worker at a time
+#define CHUNK 64
+
+// why validate_chunk rejected a board
+#define BAD_CONFLICT 1
+#define BAD_DEAD 2
+
+// longest reason replay_chunk gives for a log
+#define REASON 160
+
+// a slice of the file's boards
+typedef struct {
+    const store *in;
+    int first;
+    int count;
+
+    // the file the chunk's boards go to (at their own offset), set if any
+    // chunk couldn't write them, and where its solution counts go
+    int out;
+    int *unwritten;
+    int *counts;
+
+    // ENGINE_* to solve with, or solutions to count up to
+    int engine;
+    int cap;
+
+    // GRADE_* of boards to generate, and the chunk's random seed
+    int grade;
+    unsigned long long seed;
+
+    // every move log to replay, and why each one failed (indexed like the
+    // boards of a file, by first)
+    char *const *logs;
+    char (*reasons)[REASON];
+
+    int unsolved;
+} chunk;
+
+
+/*
+ * Writes a chunk's boards to out, where they go in the raw layout: only a
+ * chunk's worth of boards is ever held in memory, however big the file
+*/
+
+static void write_chunk(chunk *c, int (*boards)[N][N]) {
+    size_t size = (size_t) c->count * CELLS * INTSIZE, done = 0;
+    off_t at = (off_t) (c->first - 1) * CELLS * INTSIZE;
+    while(boards != NULL && done < size) {
+        ssize_t n = pwrite(c->out, (char *) boards + done, size - done, at + done);
+        if(n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    if(done < size) {
+        __atomic_store_n(c->unwritten, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * Task: copies a chunk's boards out of the mapped file, solves them and
+ * writes them out
+*/
+
+static void solve_chunk(void *arg) {
+    chunk *c = arg;
+
+    int (*boards)[N][N] = malloc((size_t) c->count * CELLS * INTSIZE);
+    if(boards == NULL) {
+        c->unsolved = c->count;
+    }
+    for(int i = 0; boards != NULL && i < c->count; i++) {
+
+        // a board that can't be read goes out empty rather than half read
+        if(!store_read(c->in, c->first + i, boards[i])) {
+            memset(boards[i], 0, CELLS * INTSIZE);
+            c->unsolved++;
+        } else if(!solveWith(c->engine, boards[i], NULL)) {
+            c->unsolved++;
+        }
+    }
+    write_chunk(c, boards);
+    free(boards);
+}
+
+/*
+ * Task: counts the solutions of a chunk's boards, up to the cap, with the
+ * chunk's engine (each board on all cores if it's ENGINE_PARALLEL)
+*/
+
+static void count_chunk(void *arg) {
+    chunk *c = arg;
+
+    for(int i = 0; i < c->count; i++) {
+        int board[N][N];
+        if(!store_read(c->in, c->first + i, board)) {
+            c->counts[i] = 0;
+        } else {
+            c->counts[i] = countWith(c->engine, board, c->cap, NULL);
+        }
+        if(c->counts[i] != 1) {
+            c->unsolved++;
+        }
+    }
+}
+
+/*
+ * Task: checks a chunk's boards LANES at a time. counts[i] becomes 0 if the
+ * board is fine, BAD_CONFLICT or BAD_DEAD otherwise
+*/
+
+static void validate_chunk(void *arg) {
+    chunk *c = arg;
+    board_batch batch;
+    digit_mask cand[CELLS][LANES];
+
+    for(int i = 0; i < c->count; i += LANES) {
+        int lanes = (c->count - i < LANES) ? c->count - i : LANES;
+        unsigned unreadable = 0;
+        for(int b = 0; b < LANES; b++) {
+            int board[N][N] = { { 0 } };
+            if(b < lanes && !store_read(c->in, c->first + i + b, board)) {
+                unreadable |= 1u << b;
+            }
+            batchLoad(&batch, b, board);
+        }
+
+        unsigned conflicts, dead;
+        batchCandidates(&batch, cand, &conflicts, &dead);
+        conflicts |= unreadable;
+        for(int b = 0; b < lanes; b++) {
+            c->counts[i + b] = (conflicts >> b & 1) ? BAD_CONFLICT : (dead >> b & 1) ? BAD_DEAD : 0;
+            if(c->counts[i + b] != 0) {
+                c->unsolved++;
+            }
+        }
+    }
+}
+
+/*
+ * Task: generates a chunk's boards, each chunk from its own seed, counting
+ * those that aren't of the grade asked for as unsolved
+*/
+
+static void generate_chunk(void *arg) {
+    chunk *c = arg;
+    unsigned long long rng;
+
+    int (*boards)[N][N] = malloc((size_t) c->count * CELLS * INTSIZE);
+    seedGenerator(&rng, c->seed + c->first);
+    for(int i = 0; boards != NULL && i < c->count; i++) {
+        if(!generateBoard(boards[i], c->grade, &rng)) {
+            c->unsolved++;
+        }
+    }
+    write_chunk(c, boards);
+    free(boards);
+}
+
+/*
+ * Task: grades a chunk's boards by logic. counts[i] becomes the hardest
+ * technique board i needs (TECHNIQUES if logic gets stuck), or -1 if it
+ * can't be read
+*/
+
+static void grade_chunk(void *arg) {
+    chunk *c = arg;
+
+    for(int i = 0; i < c->count; i++) {
+        int board[N][N];
+        c->counts[i] = store_read(c->in, c->first + i, board) ? gradeLogic(board, NULL) : -1;
+        if(c->counts[i] < 0) {
+            c->unsolved++;
+        }
+    }
+}
+
+/*
+ * Task: replays a chunk's move logs. counts[i] becomes the number of
+ * keypresses replayed, and the log's reason is left empty if they all
+ * matched
+*/
+
+static void replay_chunk(void *arg) {
+    chunk *c = arg;
+
+    for(int i = 0; i < c->count; i++) {
+        int n = c->first - 1 + i;
+        long keys;
+        c->reasons[n][0] = '\0';
+        if(movelog_replay(c->logs[n], &keys, c->reasons[n], REASON) != 1) {
+            c->unsolved++;
+        }
+        c->counts[i] = keys;
+    }
+}
+
+/*
+ * Deals count boards out to the shared pool in chunks of CHUNK, each a copy
+ * of job handled by fn; idle workers steal from busy ones. job's counts, if
+ * not NULL, are split along. Returns how many boards fn flagged
+ * (or -1 on failure)
+*/
+
+static int run_chunks(const chunk *job, int count, task_fn fn, double *ms, int *threads) {
+    int chunks = (count + CHUNK - 1) / CHUNK;
+    chunk *work = calloc(chunks, sizeof(chunk));
+    pool *p = pool_shared();
+    if(work == NULL || p == NULL) {
+        free(work);
+        return -1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    future done;
+    future_init(&done);
+    for(int i = 0; i < chunks; i++) {
+        work[i] = *job;
+        work[i].first = i * CHUNK + 1;
+        work[i].count = (i == chunks - 1) ? count - i * CHUNK : CHUNK;
+        work[i].counts = (job->counts != NULL) ? job->counts + i * CHUNK : NULL;
+        work[i].unsolved = 0;
+        pool_async(p, &done, fn, &work[i]);
+    }
+    future_wait(&done);
+    future_destroy(&done);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    *threads = pool_size(p);
+
+    int flagged = 0;
+    for(int i = 0; i < chunks; i++) {
+        flagged += work[i].unsolved;
+    }
+    free(work);
+    return flagged;
+}
+
+int solve_all(const char *path, const char *out, int engine) {
+    store in;
+    if(!store_open(&in, path)) {
+        fprintf(stderr, "Could not read boards from %s!\n", path);
+        return 1;
+    }
+    int count = in.count;
+
+    // default output: foo.bin -> foo.solved.bin
+    char name[strlen(path) + 12];
+    if(out == NULL) {
+        size_t len = strlen(path);
+        if(len > 4 && strcmp(path + len - 4, ".bin") == 0) {
+            len -= 4;
+        }
+        sprintf(name, "%.*s.solved.bin", (int) len, path);
+        out = name;
+    }
+
+    // chunks write their solutions as they go (unsolvable boards as they
+    // were), so the output mustn't be the mapped input
+    struct stat from, to;
+    if(stat(path, &from) == 0 && stat(out, &to) == 0 && from.st_dev == to.st_dev && from.st_ino == to.st_ino) {
+        fprintf(stderr, "Could not write solutions over the boards of %s!\n", path);
+        store_close(&in);
+        return 1;
+    }
+    int fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        fprintf(stderr, "Could not write solutions to %s!\n", out);
+        store_close(&in);
+        return 1;
+    }
+
+    double ms;
+    int threads;
+    int unwritten = 0;
+    chunk job = { .in = &in, .out = fd, .unwritten = &unwritten, .engine = engine };
+    int unsolved = run_chunks(&job, count, solve_chunk, &ms, &threads);
+    int ok = (close(fd) == 0) && unsolved >= 0 && !unwritten;
+    if(!ok) {
+        fprintf(stderr, "Could not write solutions to %s!\n", out);
+        remove(out);
+    } else {
+        fprintf(stderr, "solved %d of %d boards with %s in %.1f ms on %d threads -> %s\n",
+                count - unsolved, count, engineName(engine), ms, threads, out);
+    }
+
+    store_close(&in);
+    return (ok && unsolved == 0) ? 0 : 1;
+}
+
+int audit_all(const char *path, int cap, int engine) {
+    if(!engineCounts(engine)) {
+        fprintf(stderr, "The %s engine can't count solutions!\n", engineName(engine));
+        return 1;
+    }
+
+    store in;
+    if(!store_open(&in, path)) {
+        fprintf(stderr, "Could not read boards from %s!\n", path);
+        return 1;
+    }
+
+    double ms;
+    int threads;
+    int *counts = calloc(in.count, sizeof(int));
+    chunk job = { .in = &in, .counts = counts, .cap = cap, .engine = engine };
+    int flagged = (counts != NULL) ? run_chunks(&job, in.count, count_chunk, &ms, &threads) : -1;
+    if(flagged < 0) {
+        free(counts);
+        store_close(&in);
+        return 1;
+    }
+
+    // one line per board without exactly one solution
+    int none = 0;
+    for(int n = 1; n <= in.count; n++) {
+        int found = counts[n - 1];
+        if(found == 0) {
+            printf("%s #%d: no solution\n", path, n);
+            none++;
+        } else if(found > 1) {
+            printf("%s #%d: %s%d solutions\n", path, n, (found == cap) ? ">= " : "", found);
+        }
+    }
+    fprintf(stderr, "audited %d boards in %.1f ms on %d threads: %d unique, %d unsolvable, %d with several solutions\n",
+            in.count, ms, threads, in.count - flagged, none, flagged - none);
+
+    free(counts);
+    store_close(&in);
+    return (flagged == 0) ? 0 : 1;
+}
+
+int validate_all(const char *path) {
+    store in;
+    if(!store_open(&in, path)) {
+        fprintf(stderr, "Could not read boards from %s!\n", path);
+        return 1;
+    }
+
+    double ms;
+    int threads;
+    int *counts = calloc(in.count, sizeof(int));
+    chunk job = { .in = &in, .counts = counts };
+    int flagged = (counts != NULL) ? run_chunks(&job, in.count, validate_chunk, &ms, &threads) : -1;
+    if(flagged < 0) {
+        free(counts);
+        store_close(&in);
+        return 1;
+    }
+
+    // one line per invalid board
+    for(int n = 1; n <= in.count; n++) {
+        if(counts[n - 1] == BAD_CONFLICT) {
+            printf("%s #%d: givens conflict\n", path, n);
+        } else if(counts[n - 1] == BAD_DEAD) {
+            printf("%s #%d: cell without candidates\n", path, n);
+        }
+    }
+    fprintf(stderr, "validated %d boards in %.1f ms (%.0f boards/s) on %d threads with %s: %d invalid\n",
+            in.count, ms, (ms > 0) ? in.count / (ms / 1e3) : 0.0, threads, batchKernel(), flagged);
+
+    free(counts);
+    store_close(&in);
+    return (flagged == 0) ? 0 : 1;
+}
+
+int grade_all(const char *path) {
+    store in;
+    if(!store_open(&in, path)) {
+        fprintf(stderr, "Could not read boards from %s!\n", path);
+        return 1;
+    }
+
+    double ms;
+    int threads;
+    int *counts = calloc(in.count, sizeof(int));
+    chunk job = { .in = &in, .counts = counts };
+    int flagged = (counts != NULL) ? run_chunks(&job, in.count, grade_chunk, &ms, &threads) : -1;
+    if(flagged < 0) {
+        free(counts);
+        store_close(&in);
+        return 1;
+    }
+
+    // one line per board, and how many boards each technique was the hardest of
+    int hardest[TECHNIQUES + 1] = { 0 };
+    for(int n = 1; n <= in.count; n++) {
+        int t = counts[n - 1];
+        if(t < 0) {
+            printf("%s #%d: unreadable\n", path, n);
+        } else {
+            printf("%s #%d: %s\n", path, n, techniqueName(t));
+            hardest[t]++;
+        }
+    }
+    fprintf(stderr, "graded %d boards in %.1f ms (%.0f boards/s) on %d threads:",
+            in.count, ms, (ms > 0) ? in.count / (ms / 1e3) : 0.0, threads);
+    for(int t = 0; t <= TECHNIQUES; t++) {
+        if(hardest[t] > 0) {
+            fprintf(stderr, " %d %s,", hardest[t], techniqueName(t));
+        }
+    }
+    fprintf(stderr, " %d unreadable\n", flagged);
+
+    free(counts);
+    store_close(&in);
+    return (flagged == 0) ? 0 : 1;
+}
+
+/*
+ * A seed for a run that wasn't given one: the time to the nanosecond, with
+ * the process id, so that runs started together still differ
+*/
+
+static unsigned long long fresh_seed(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return ((unsigned long long) t.tv_sec * 1000000000ULL + t.tv_nsec) ^ ((unsigned long long) getpid() << 40);
+}
+
+int generate_all(const char *level, int count, const char *out, const unsigned long long *seed) {
+    int grade;
+    switch(store_level(level)) {
+        case LEVEL_DEBUG:
+        case LEVEL_N00B:
+            grade = GRADE_SINGLES;
+            break;
+        case LEVEL_L33T:
+            grade = GRADE_HARDER;
+            break;
+        default:
+            fprintf(stderr, "Unknown level %s!\n", level);
+            return 1;
+    }
+
+    // chunks write their boards as they go, in the same layout as the
+    // shipped *.bin files
+    int fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        fprintf(stderr, "Could not write boards to %s!\n", out);
+        return 1;
+    }
+
+    double ms;
+    int threads;
+    int unwritten = 0;
+    chunk job = { .out = fd, .unwritten = &unwritten, .grade = grade, .seed = (seed != NULL) ? *seed : fresh_seed() };
+    int off = run_chunks(&job, count, generate_chunk, &ms, &threads);
+    int ok = (close(fd) == 0) && off >= 0 && !unwritten;
+    if(!ok) {
+        fprintf(stderr, "Could not write boards to %s!\n", out);
+        remove(out);
+    } else {
+        fprintf(stderr, "generated %d %s boards in %.1f ms (%.0f boards/s) on %d threads with seed %llu -> %s\n",
+                count, level, ms, (ms > 0) ? count / (ms / 1e3) : 0.0, threads, job.seed, out);
+        if(off > 0) {
+            fprintf(stderr, "%d of them are off-grade: no %s board turned up for them in time\n", off, level);
+        }
+    }
+    return (ok && off == 0) ? 0 : 1;
+}
+
+int replay_all(char *const logs[], int count) {
+    double ms;
+    int threads;
+    int *keys = calloc(count, sizeof(int));
+    char (*reasons)[REASON] = calloc(count, REASON);
+    chunk job = { .logs = logs, .reasons = reasons, .counts = keys };
+    int flagged = (keys != NULL && reasons != NULL) ? run_chunks(&job, count, replay_chunk, &ms, &threads) : -1;
+    if(flagged < 0) {
+        free(keys);
+        free(reasons);
+        return 1;
+    }
+
+    // one line per log that didn't replay as logged
+    long total = 0;
+    for(int i = 0; i < count; i++) {
+        total += keys[i];
+        if(reasons[i][0] != '\0') {
+            printf("%s: %s\n", logs[i], reasons[i]);
+        }
+    }
+    fprintf(stderr, "replayed %d logs (%ld keypresses) in %.1f ms (%.0f keypresses/s) on %d threads: %d mismatched\n",
+            count, total, ms, (ms > 0) ? total / (ms / 1e3) : 0.0, threads, flagged);
+
+    free(keys);
+    free(reasons);
+    return (flagged == 0) ? 0 : 1;
+}
+
+int pack_file(const char *path, const char *out) {
+    store in;
+    if(!store_open(&in, path)) {
+        fprintf(stderr, "Could not read boards from %s!\n", path);
+        return 1;
+    }
+
+    // level comes from the file's name, e.g. levels/l33t.bin
+    const char *base = strrchr(path, '/');
+    base = (base == NULL) ? path : base + 1;
+    size_t len = strcspn(base, ".");
+    char name[len + 1];
+    sprintf(name, "%.*s", (int) len, base);
+
+    struct stat from, to;
+    if(stat(path, &from) == 0 && stat(out, &to) == 0 && from.st_dev == to.st_dev && from.st_ino == to.st_ino) {
+        fprintf(stderr, "Could not pack the boards of %s over themselves!\n", path);
+        store_close(&in);
+        return 1;
+    }
+    int ok = store_pack(&in, out, store_level(name));
+    if(!ok) {
+        fprintf(stderr, "Could not write packed boards to %s!\n", out);
+    } else {
+        fprintf(stderr, "packed %d boards -> %s\n", in.count, out);
+    }
+    store_close(&in);
+    return ok ? 0 : 1;
+}
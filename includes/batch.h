@@ -0,0 +1,45 @@
+/****************************************************************************
+ * batch.h
+ *
+ * Headless modes that work on whole *.bin files (or many logs) at once.
+ ***************************************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+// solves every board in path with engine (ENGINE_*) on all cores and writes
+// the solutions to out (path with .bin replaced by .solved.bin if out is
+// NULL); returns 0 iff every board was solved
+int solve_all(const char *path, const char *out, int engine);
+
+// counts the solutions of every board in path (up to cap, at least 2) with
+// engine on all cores (ENGINE_PARALLEL splitting each board across them too)
+// and prints the boards that don't have exactly one; returns 0 iff every
+// board is unique (and 1 if the engine can't count, see engineCounts)
+int audit_all(const char *path, int cap, int engine);
+
+// checks every board in path LANES at a time on all cores and prints the
+// boards whose givens conflict or leave a cell without candidates; returns
+// 0 iff every board is valid
+int validate_all(const char *path);
+
+// grades every board in path by the hardest logical technique it needs (see
+// gradeLogic in puzzle.h) on all cores, and prints each board's grade;
+// returns 0 iff every board could be read
+int grade_all(const char *path);
+
+// generates count new boards of level ("debug", "n00b" or "l33t"), each
+// with exactly one solution, on all cores and writes them to out in the
+// raw layout. The same *seed gives the same boards (a fresh seed is taken
+// from the clock and process id if seed is NULL, and printed)
+int generate_all(const char *level, int count, const char *out, const unsigned long long *seed);
+
+// replays count move logs (see movelog.h) on all cores, checking that every
+// keypress changes the board as logged, and prints the logs that don't;
+// returns 0 iff every log replays as logged
+int replay_all(char *const logs[], int count);
+
+// converts the board file at path (either format) to the packed format at out
+int pack_file(const char *path, const char *out);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Solution cache
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.h"
+
+
+/*
+ * Maps (creating or resetting it if needed) the sidecar at path. Returns 0
+ * if it can't be used
+*/
+
+static int map_sidecar(cache *c, int count, const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0) {
+        return 0;
+    }
+
+    size_t size = CACHE_HEADER + (size_t) count * CELLS;
+    unsigned char header[CACHE_HEADER] = { 0 };
+    memcpy(header, CACHE_MAGIC, 4);
+    header[4] = CACHE_VERSION;
+    header[5] = BOX;
+    for(int i = 0; i < 4; i++) {
+        header[8 + i] = (unsigned) count >> (8 * i);
+    }
+
+    // a sidecar for another version of the level file (or board size) starts over
+    struct stat st;
+    unsigned char old[CACHE_HEADER];
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size != size ||
+       pread(fd, old, CACHE_HEADER, 0) != CACHE_HEADER || memcmp(old, header, CACHE_HEADER) != 0) {
+        if(ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0 ||
+           pwrite(fd, header, CACHE_HEADER, 0) != CACHE_HEADER) {
+            close(fd);
+            return 0;
+        }
+    }
+
+    // the mapping outlives the descriptor
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return 0;
+    }
+    c->data = data;
+    c->size = size;
+    c->solutions = (compact_board *) (c->data + CACHE_HEADER);
+    return 1;
+}
+
+int cache_open(cache *c, int count, const char *path) {
+    memset(c, 0, sizeof(cache));
+    if(count <= 0) {
+        return 0;
+    }
+    c->count = count;
+
+    if(path != NULL && map_sidecar(c, count, path)) {
+        return 1;
+    }
+
+    // anonymous pages are zero-filled on first touch
+    size_t size = (size_t) count * CELLS;
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED) {
+        c->count = 0;
+        return 0;
+    }
+    c->data = data;
+    c->size = size;
+    c->solutions = (compact_board *) c->data;
+    return 1;
+}
+
+void cache_close(cache *c) {
+    if(c->data != NULL) {
+        munmap(c->data, c->size);
+    }
+    memset(c, 0, sizeof(cache));
+}
+
+int cache_get(const cache *c, int n, const compact_board *givens, compact_board *solution) {
+    if(c->data == NULL || n < 1 || n > c->count) {
+        return 0;
+    }
+
+    const unsigned char *cells = c->solutions[n - 1].cell;
+    for(int i = 0; i < CELLS; i++) {
+        int given = givens->cell[i];
+        if(cells[i] == 0 || cells[i] > N || (given != 0 && given != cells[i])) {
+            return 0;
+        }
+    }
+    *solution = c->solutions[n - 1];
+    return 1;
+}
+
+void cache_put(cache *c, int n, const compact_board *solution) {
+    if(c->data == NULL || n < 1 || n > c->count) {
+        return;
+    }
+
+    for(int i = 0; i < CELLS; i++) {
+        if(solution->cell[i] < 1 || solution->cell[i] > N) {
+            return;
+        }
+    }
+    c->solutions[n - 1] = *solution;
+}
@@ -0,0 +1,48 @@
+/****************************************************************************
+ * cache.h
+ *
+ * Solutions of a level's boards, keyed by board number, optionally
+ * persisted in a sidecar file next to the level's *.bin.
+ *
+ * The sidecar is a CACHE_HEADER-byte header (magic "SDKS", version, box
+ * size, board count) followed by CELLS bytes per board, all zeros until that
+ * board has been solved. It's memory-mapped, so lookups never touch the
+ * disk and only the pages of boards actually played take up memory.
+ ***************************************************************************/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include "sudoku.h"
+
+// sidecar's magic, version and header size (in bytes)
+#define CACHE_MAGIC "SDKS"
+#define CACHE_VERSION 1
+#define CACHE_HEADER 16
+
+typedef struct {
+    // the mapping, header included if there's a sidecar
+    unsigned char *data;
+    size_t size;
+
+    // one solution per board
+    compact_board *solutions;
+    int count;
+} cache;
+
+// opens a cache for count boards, backed by the sidecar at path (memory only
+// if path is NULL or the sidecar can't be used); returns 0 on failure
+int cache_open(cache *c, int count, const char *path);
+
+// unmaps the cache, leaving its solutions in the sidecar
+void cache_close(cache *c);
+
+// copies the solution of board n, counting from 1, into solution; returns 0
+// if it isn't cached or doesn't fit the board's givens
+int cache_get(const cache *c, int n, const compact_board *givens, compact_board *solution);
+
+// remembers the (complete) solution of board n
+void cache_put(cache *c, int n, const compact_board *solution);
+
+#endif
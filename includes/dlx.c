@@ -0,0 +1,283 @@
+/*
+ * Exact-cover solver engine with dancing links (Knuth's Algorithm X).
+ *
+ * A board is 4 * CELLS constraints (every cell filled, every digit once per
+ * row, column and square), each candidate digit of each cell covers four of
+ * them, and solving means picking CELLS candidates that cover each constraint
+ * exactly once (for 9x9 boards, 81 of 729 candidates over 324 constraints).
+ * The matrix is built once per thread; givens and guesses are covered on it
+ * and uncovered again afterwards, so solving a board never allocates.
+*/
+
+#include <stddef.h>
+#include "puzzle.h"
+
+// columns (constraints), rows (candidates) and nodes (root + headers + 4 per row)
+#define COLUMNS (4 * CELLS)
+#define ROWS (CELLS * N)
+#define NODES (1 + COLUMNS + 4 * ROWS)
+
+// node numbers: shorts are enough up to 16x16 boards
+#if NODES <= 32767
+typedef short node;
+#else
+typedef int node;
+#endif
+
+// the matrix, as circular doubly-linked lists in both directions
+typedef struct {
+    node left[NODES], right[NODES], up[NODES], down[NODES];
+
+    // each node's column header, and each row node's candidate
+    node column[NODES], row[NODES];
+
+    // number of nodes left in each column
+    node size[1 + COLUMNS];
+
+    // first node of each candidate's row
+    node first[ROWS];
+
+    // candidates picked so far, the first givens of them before the search
+    node picked[CELLS];
+    int givens;
+
+    int built;
+} matrix;
+
+// every thread solves on its own matrix
+static __thread matrix m;
+
+
+/*
+ * Links the matrix: candidate r (cell r / N, digit r % N + 1) covers its
+ * cell, and its digit in the cell's row, column and square
+*/
+
+static void build(matrix *x) {
+
+    // root (node 0) and column headers (nodes 1 to COLUMNS) in one row
+    for(int c = 0; c <= COLUMNS; c++) {
+        x->left[c] = (c == 0) ? COLUMNS : c - 1;
+        x->right[c] = (c == COLUMNS) ? 0 : c + 1;
+        x->up[c] = x->down[c] = c;
+        x->column[c] = c;
+        x->size[c] = 0;
+    }
+
+    int node = COLUMNS + 1;
+    for(int r = 0; r < ROWS; r++) {
+        int cell = r / N, digit = r % N;
+        int square = (cell / (N * BOX)) * BOX + (cell % N) / BOX;
+        int columns[4] = {
+            1 + cell,
+            1 + CELLS + (cell / N) * N + digit,
+            1 + 2 * CELLS + (cell % N) * N + digit,
+            1 + 3 * CELLS + square * N + digit
+        };
+
+        x->first[r] = node;
+        for(int k = 0; k < 4; k++) {
+            int c = columns[k];
+
+            // append below the column's last node
+            x->column[node] = c;
+            x->row[node] = r;
+            x->up[node] = x->up[c];
+            x->down[node] = c;
+            x->down[x->up[c]] = node;
+            x->up[c] = node;
+            x->size[c]++;
+
+            // and after the row's previous node
+            x->left[node] = (k == 0) ? node : node - 1;
+            x->right[node] = (k == 3) ? node - 3 : node + 1;
+            if(k == 3) {
+                x->left[node - 3] = node;
+            }
+            node++;
+        }
+    }
+    x->built = 1;
+}
+
+/*
+ * Takes column c out of the header list, and every row through c out of the other columns
+*/
+
+static void cover(matrix *x, int c) {
+    x->left[x->right[c]] = x->left[c];
+    x->right[x->left[c]] = x->right[c];
+
+    for(int i = x->down[c]; i != c; i = x->down[i]) {
+        for(int j = x->right[i]; j != i; j = x->right[j]) {
+            x->up[x->down[j]] = x->up[j];
+            x->down[x->up[j]] = x->down[j];
+            x->size[x->column[j]]--;
+        }
+    }
+}
+
+/*
+ * Exactly undoes cover(c)
+*/
+
+static void uncover(matrix *x, int c) {
+    for(int i = x->up[c]; i != c; i = x->up[i]) {
+        for(int j = x->left[i]; j != i; j = x->left[j]) {
+            x->size[x->column[j]]++;
+            x->up[x->down[j]] = j;
+            x->down[x->up[j]] = j;
+        }
+    }
+
+    x->left[x->right[c]] = c;
+    x->right[x->left[c]] = c;
+}
+
+/*
+ * Picks the row of node r: covers every other column it's in
+*/
+
+static void pick(matrix *x, int r) {
+    for(int j = x->right[r]; j != r; j = x->right[j]) {
+        cover(x, x->column[j]);
+    }
+}
+
+static void unpick(matrix *x, int r) {
+    for(int j = x->left[r]; j != r; j = x->left[j]) {
+        uncover(x, x->column[j]);
+    }
+}
+
+/*
+ * Algorithm X on the columns left, branching on the smallest one, until cap
+ * solutions are found (the first one's candidates are then left in picked).
+ * Returns how many were. Leaves the matrix as it found it
+*/
+
+static int search(matrix *x, int depth, int cap, solve_stats *stats) {
+
+    if(stats != NULL) {
+        stats->calls++;
+    }
+    if(CANCELLED(stats)) {
+        return 0;
+    }
+    STAT_DEPTH(stats, depth - x->givens + 1);
+    if(x->right[0] == 0) {
+        return 1;
+    }
+
+    int c = x->right[0];
+    for(int j = x->right[c]; j != 0; j = x->right[j]) {
+        STAT_ADD(stats, tests, 1);
+        if(x->size[j] < x->size[c]) {
+            c = j;
+        }
+    }
+    if(x->size[c] == 0) {
+        return 0;
+    }
+
+    int found = 0;
+    int options = x->size[c];
+    cover(x, c);
+    for(int r = x->down[c]; r != c && found < cap; r = x->down[r]) {
+        if(stats != NULL && options > 1) {
+            stats->guesses++;
+        }
+        x->picked[depth] = x->row[r];
+        pick(x, r);
+        int below = search(x, depth + 1, cap - found, stats);
+        unpick(x, r);
+        STAT_ADD(stats, backtracks, below == 0);
+        found += below;
+    }
+    uncover(x, c);
+    return found;
+}
+
+/*
+ * Covers the board's givens, searches for up to cap solutions and puts the
+ * matrix back for the next board. Returns how many were found (0 if the
+ * givens already conflict)
+*/
+
+static int solve(int board[N][N], int cap, solve_stats *stats) {
+
+    matrix *x = &m;
+    if(!x->built) {
+        build(x);
+    }
+
+    // givens must not conflict: each covers its four columns for good
+    digit_mask rows[N] = { 0 }, cols[N] = { 0 }, squares[N] = { 0 };
+    int givens[CELLS];
+    int n = 0;
+    for(int i = 0; i < CELLS; i++) {
+        int num = board[i / N][i % N];
+        if(num == 0) {
+            continue;
+        }
+        if(num < 0 || num > N) {
+            return 0;
+        }
+        int s = (i / (N * BOX)) * BOX + (i % N) / BOX;
+        digit_mask bit = 1u << num;
+        if((rows[i / N] | cols[i % N] | squares[s]) & bit) {
+            return 0;
+        }
+        rows[i / N] |= bit;
+        cols[i % N] |= bit;
+        squares[s] |= bit;
+        givens[n++] = x->first[i * N + num - 1];
+    }
+
+    for(int k = 0; k < n; k++) {
+        x->picked[k] = x->row[givens[k]];
+        cover(x, x->column[givens[k]]);
+        pick(x, givens[k]);
+    }
+
+    x->givens = n;
+    int found = search(x, n, cap, stats);
+
+    // put the matrix back for the next board
+    for(int k = n - 1; k >= 0; k--) {
+        unpick(x, givens[k]);
+        uncover(x, x->column[givens[k]]);
+    }
+    return found;
+}
+
+/*
+ * Solves the board in place. Returns 1 if solved, 0 if there's no solution
+ * (or the givens already conflict), in which case the board is left untouched.
+ * Counts into stats unless it's NULL, and gives up (returning 0) once
+ * *stats->cancel is set
+*/
+
+int solveDlx(int board[N][N], solve_stats *stats) {
+
+    matrix *x = &m;
+    if(!solve(board, 1, stats)) {
+        return 0;
+    }
+    for(int k = 0; k < CELLS; k++) {
+        int r = x->picked[k];
+        board[(r / N) / N][(r / N) % N] = r % N + 1;
+    }
+    return 1;
+}
+
+/*
+ * Returns how many solutions the board has, counting no further than cap
+ * (and what it has counted so far once *stats->cancel is set). The board
+ * isn't changed
+*/
+
+int countDlx(int board[N][N], int cap, solve_stats *stats) {
+
+    return (cap < 1) ? 0 : solve(board, cap, stats);
+}
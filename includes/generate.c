@@ -0,0 +1,134 @@
+/*
+ * Puzzle generator.
+ *
+ * Makes a random full grid (the BOX independent squares on the diagonal
+ * filled at random, the rest solved for), then empties its cells in random
+ * order, putting back any digit whose removal lets the board have a second
+ * solution.
+ * The result is graded by the techniques the logical engine needs for it:
+ * singles alone, or anything harder (guessing included).
+*/
+
+#include <stddef.h>
+#include "puzzle.h"
+
+// givens left on a GRADE_SINGLES board (36 on 9x9 boards; the shipped n00b
+// boards have 28 to 37)
+#define EASY_GIVENS (CELLS * 4 / 9)
+
+// calls the mask engine gets to prove a board unique before the digit is
+// put back anyway (large boards can take millions)
+#define LIMIT 256
+
+// boards tried for the grade asked for before settling for the last one
+// (4x4 boards hardly ever need more than singles, 25x25 ones hardly ever
+// do without)
+#define TRIES 64
+
+
+/*
+ * xorshift64*: returns the next number of the sequence in *rng (never 0)
+*/
+
+static unsigned long long next(unsigned long long *rng) {
+    unsigned long long x = *rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *rng = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/*
+ * Shuffles the n ints of a in place
+*/
+
+static void shuffle(int *a, int n, unsigned long long *rng) {
+    for(int i = n - 1; i > 0; i--) {
+        int j = next(rng) % (i + 1);
+        int t = a[i];
+        a[i] = a[j];
+        a[j] = t;
+    }
+}
+
+/*
+ * Fills board with a random solved grid
+*/
+
+static void fill(int board[N][N], unsigned long long *rng) {
+
+    // the squares on the diagonal don't constrain each other, though on 4x4
+    // boards they can leave the other two without a solution
+    do {
+        for(int i = 0; i < CELLS; i++) {
+            board[i / N][i % N] = 0;
+        }
+        for(int s = 0; s < BOX; s++) {
+            int digits[N];
+            for(int k = 0; k < N; k++) {
+                digits[k] = k + 1;
+            }
+            shuffle(digits, N, rng);
+            for(int k = 0; k < N; k++) {
+                board[s * BOX + k / BOX][s * BOX + k % BOX] = digits[k];
+            }
+        }
+    } while(!solveMask(board, NULL));
+}
+
+/*
+ * Seeds *rng from seed (any value, 0 included)
+*/
+
+void seedGenerator(unsigned long long *rng, unsigned long long seed) {
+
+    // splitmix64, so that nearby seeds give unrelated sequences
+    unsigned long long z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    *rng = (z != 0) ? z : 1;
+}
+
+/*
+ * Fills board with a new puzzle of the given grade (GRADE_*) that has
+ * exactly one solution, drawing from *rng. Returns 0 if it had to settle
+ * for a board of the other grade
+*/
+
+int generateBoard(int board[N][N], int grade, unsigned long long *rng) {
+
+    for(int tries = 1; ; tries++) {
+        fill(board, rng);
+
+        int cells[CELLS];
+        for(int i = 0; i < CELLS; i++) {
+            cells[i] = i;
+        }
+        shuffle(cells, CELLS, rng);
+
+        // easy boards keep some givens to spare, hard ones keep only what uniqueness needs
+        int givens = CELLS;
+        for(int k = 0; k < CELLS && (grade != GRADE_SINGLES || givens > EASY_GIVENS); k++) {
+            int y = cells[k] / N, x = cells[k] % N;
+            int num = board[y][x];
+            board[y][x] = 0;
+            solve_stats budget = { .limit = LIMIT };
+            if(countMask(board, 2, &budget) != 1) {
+                board[y][x] = num;
+            } else {
+                givens--;
+            }
+        }
+
+        int copy[N][N];
+        for(int i = 0; i < CELLS; i++) {
+            copy[i / N][i % N] = board[i / N][i % N];
+        }
+        int singles = gradeLogic(copy, NULL) <= TECH_HIDDEN_SINGLE;
+        if(singles == (grade == GRADE_SINGLES) || tries == TRIES) {
+            return singles == (grade == GRADE_SINGLES);
+        }
+    }
+}
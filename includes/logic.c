@@ -0,0 +1,640 @@
+/*
+ * Logical solver engine: the techniques a person would use, easiest first.
+ *
+ * A sheet keeps every empty cell's candidates as a mask, and for every unit
+ * and digit the cells of the unit (bit k for its k-th cell) where the digit
+ * can still go. Placing a digit or eliminating a candidate updates both in
+ * place, so techniques never recompute candidates; they only look at masks.
+ * Each step is the first deduction of the easiest technique that makes one,
+ * which is how boards are graded (by the hardest technique they need) and
+ * how hints are found.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "puzzle.h"
+
+// bits 1 to N set, one per digit
+#define ALL ((digit_mask) ((1u << (N + 1)) - 2))
+
+// bits 0 to N - 1 set, one per cell of a unit (or per line)
+#define EVERY ((1u << N) - 1)
+
+// units (rows, columns and squares) of cell i
+#define ROW(i) ((i) / N)
+#define COLUMN(i) (N + (i) % N)
+#define SQUARE(i) (2 * N + ((i) / (N * BOX)) * BOX + ((i) % N) / BOX)
+
+// a board being solved by logic
+typedef struct {
+    // the board's cells (0 if empty), and the candidates of empty ones
+    unsigned char cell[CELLS];
+    digit_mask cand[CELLS];
+
+    // where[u][d]: cells of unit u where digit d can go (0 once it's placed there)
+    unsigned where[3 * N][N + 1];
+
+    // digits placed in each unit
+    digit_mask placed[3 * N];
+
+    // number of empty cells, and whether the board turned out to have no solution
+    int left;
+    int broken;
+} sheet;
+
+static const char *names[TECHNIQUES] = {
+    [TECH_NAKED_SINGLE] = "naked single",
+    [TECH_HIDDEN_SINGLE] = "hidden single",
+    [TECH_POINTING] = "pointing",
+    [TECH_CLAIMING] = "claiming",
+    [TECH_NAKED_PAIR] = "naked pair",
+    [TECH_HIDDEN_PAIR] = "hidden pair",
+    [TECH_NAKED_TRIPLE] = "naked triple",
+    [TECH_HIDDEN_TRIPLE] = "hidden triple",
+    [TECH_X_WING] = "X-wing",
+    [TECH_SWORDFISH] = "swordfish",
+};
+
+
+/*
+ * Returns the k-th cell (0 to N - 1) of unit u
+*/
+
+static inline int unitCell(int u, int k) {
+    if(u < N) {
+        return u * N + k;
+    } else if(u < 2 * N) {
+        return k * N + (u - N);
+    } else {
+        u -= 2 * N;
+        return ((u / BOX) * BOX + k / BOX) * N + (u % BOX) * BOX + k % BOX;
+    }
+}
+
+/*
+ * Returns which cell of unit u (one of cell i's) cell i is
+*/
+
+static inline int unitIndex(int u, int i) {
+    if(u < N) {
+        return i % N;
+    } else if(u < 2 * N) {
+        return i / N;
+    } else {
+        return (i / N % BOX) * BOX + i % N % BOX;
+    }
+}
+
+/*
+ * Takes digit d out of cell i's candidates. Returns 1 if it was one
+*/
+
+static int eliminate(sheet *s, int i, int d) {
+    digit_mask bit = (digit_mask) (1u << d);
+    if(!(s->cand[i] & bit)) {
+        return 0;
+    }
+    s->cand[i] &= ~bit;
+    if(s->cand[i] == 0) {
+        s->broken = 1;
+    }
+
+    int units[3] = { ROW(i), COLUMN(i), SQUARE(i) };
+    for(int k = 0; k < 3; k++) {
+        int u = units[k];
+        s->where[u][d] &= ~(1u << unitIndex(u, i));
+        if(s->where[u][d] == 0 && !(s->placed[u] & bit)) {
+            s->broken = 1;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Writes digit d into the empty cell i, and takes it out of its peers' candidates
+*/
+
+static void place(sheet *s, int i, int d) {
+    digit_mask bit = (digit_mask) (1u << d);
+    int units[3] = { ROW(i), COLUMN(i), SQUARE(i) };
+
+    if(!(s->cand[i] & bit)) {
+        s->broken = 1;
+        return;
+    }
+    for(int e = 1; e <= N; e++) {
+        if(e != d) {
+            eliminate(s, i, e);
+        }
+    }
+    s->cell[i] = d;
+    s->cand[i] = 0;
+    s->left--;
+    for(int k = 0; k < 3; k++) {
+        s->placed[units[k]] |= bit;
+        s->where[units[k]][d] = 0;
+    }
+    for(int k = 0; k < 3; k++) {
+        for(int j = 0; j < N; j++) {
+            int peer = unitCell(units[k], j);
+            if(s->cell[peer] == 0) {
+                eliminate(s, peer, d);
+            }
+        }
+    }
+}
+
+/*
+ * Sets the sheet up for board, placing its givens one by one. Returns 0 if
+ * a given isn't 0 to N
+*/
+
+static int load(sheet *s, int board[N][N]) {
+    memset(s, 0, sizeof(sheet));
+    s->left = CELLS;
+    for(int i = 0; i < CELLS; i++) {
+        s->cand[i] = ALL;
+    }
+    for(int u = 0; u < 3 * N; u++) {
+        for(int d = 1; d <= N; d++) {
+            s->where[u][d] = EVERY;
+        }
+    }
+    for(int i = 0; i < CELLS; i++) {
+        int num = board[i / N][i % N];
+        if(num < 0 || num > N) {
+            return 0;
+        }
+        if(num != 0) {
+            place(s, i, num);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Singles: a cell with one candidate left, or a digit with one cell left in a unit
+*/
+
+static int nakedSingle(sheet *s, logic_step *step) {
+    for(int i = 0; i < CELLS; i++) {
+        if(s->cell[i] == 0 && __builtin_popcount(s->cand[i]) == 1) {
+            step->cell = i;
+            step->digit = __builtin_ctz(s->cand[i]);
+            step->unit = -1;
+            place(s, i, step->digit);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int hiddenSingle(sheet *s, logic_step *step) {
+
+    // squares first, then rows and columns, as people tend to look
+    for(int v = 0; v < 3 * N; v++) {
+        int u = (v + 2 * N) % (3 * N);
+        for(int d = 1; d <= N; d++) {
+            if(__builtin_popcount(s->where[u][d]) == 1) {
+                step->cell = unitCell(u, __builtin_ctz(s->where[u][d]));
+                step->digit = d;
+                step->unit = u;
+                place(s, step->cell, d);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Pointing: a digit confined to one row or column within a square is
+ * nowhere else in that line. Claiming: a digit confined to one square
+ * within a line is nowhere else in that square
+*/
+
+static int pointing(sheet *s, logic_step *step) {
+    for(int u = 2 * N; u < 3 * N; u++) {
+        for(int d = 1; d <= N; d++) {
+            unsigned w = s->where[u][d];
+            if(__builtin_popcount(w) < 2) {
+                continue;
+            }
+
+            // the square's cells k in one row share k / BOX, in one column k % BOX
+            int rows = 0, columns = 0;
+            for(int k = 0; k < N; k++) {
+                if(w >> k & 1) {
+                    rows |= 1 << (k / BOX);
+                    columns |= 1 << (k % BOX);
+                }
+            }
+            int first = unitCell(u, __builtin_ctz(w));
+            int line = (__builtin_popcount(rows) == 1) ? ROW(first) :
+                       (__builtin_popcount(columns) == 1) ? COLUMN(first) : -1;
+            if(line < 0) {
+                continue;
+            }
+
+            int eliminated = 0;
+            for(int k = 0; k < N; k++) {
+                int i = unitCell(line, k);
+                if(s->cell[i] == 0 && SQUARE(i) != u) {
+                    eliminated += eliminate(s, i, d);
+                }
+            }
+            if(eliminated > 0) {
+                step->unit = u;
+                step->digit = d;
+                step->cover = line;
+                step->eliminated = eliminated;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int claiming(sheet *s, logic_step *step) {
+    for(int u = 0; u < 2 * N; u++) {
+        for(int d = 1; d <= N; d++) {
+            unsigned w = s->where[u][d];
+            if(__builtin_popcount(w) < 2) {
+                continue;
+            }
+
+            // a line's cells k in one square share k / BOX
+            int squares = 0;
+            for(int k = 0; k < N; k++) {
+                if(w >> k & 1) {
+                    squares |= 1 << (k / BOX);
+                }
+            }
+            if(__builtin_popcount(squares) != 1) {
+                continue;
+            }
+
+            int square = SQUARE(unitCell(u, __builtin_ctz(w)));
+            int eliminated = 0;
+            for(int k = 0; k < N; k++) {
+                int i = unitCell(square, k);
+                if(s->cell[i] == 0 && ROW(i) != u && COLUMN(i) != u) {
+                    eliminated += eliminate(s, i, d);
+                }
+            }
+            if(eliminated > 0) {
+                step->unit = u;
+                step->digit = d;
+                step->cover = square;
+                step->eliminated = eliminated;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// what to do with a set of size items whose masks cover exactly size bits
+typedef int (*use_fn)(sheet *s, int u, unsigned items, unsigned cover, logic_step *step);
+
+/*
+ * Tries every set of size items (bit k of items for masks[k], skipping
+ * empty masks) whose masks cover no more than size bits between them, and
+ * returns 1 as soon as use makes progress with one of them
+*/
+
+static int subsets(sheet *s, int u, const unsigned masks[N], int size, int from, unsigned items,
+                   unsigned cover, use_fn use, logic_step *step) {
+    if(__builtin_popcount(items) == size) {
+        return __builtin_popcount(cover) == size && use(s, u, items, cover, step);
+    }
+    for(int k = from; k < N; k++) {
+        if(masks[k] != 0 && __builtin_popcount(cover | masks[k]) <= size &&
+           subsets(s, u, masks, size, k + 1, items | 1u << k, cover | masks[k], use, step)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Naked subsets: size cells of unit u (items) whose candidates are size
+ * digits (cover) between them take those digits from the unit's other cells
+*/
+
+static int useNaked(sheet *s, int u, unsigned items, unsigned cover, logic_step *step) {
+    int eliminated = 0;
+    for(int k = 0; k < N; k++) {
+        int i = unitCell(u, k);
+        if(s->cell[i] != 0 || (items >> k & 1)) {
+            continue;
+        }
+        for(int d = 1; d <= N; d++) {
+            if(cover >> d & 1) {
+                eliminated += eliminate(s, i, d);
+            }
+        }
+    }
+    step->unit = u;
+    step->cells = items;
+    step->digits = cover;
+    step->eliminated = eliminated;
+    return eliminated > 0;
+}
+
+static int naked(sheet *s, int size, logic_step *step) {
+    for(int u = 0; u < 3 * N; u++) {
+        unsigned masks[N];
+        for(int k = 0; k < N; k++) {
+            int i = unitCell(u, k);
+            masks[k] = (s->cell[i] == 0 && __builtin_popcount(s->cand[i]) >= 2) ? s->cand[i] : 0;
+        }
+        if(subsets(s, u, masks, size, 0, 0, 0, useNaked, step)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Hidden subsets: size digits (items, bit d - 1 for digit d) that fit in
+ * only size cells of unit u (cover) between them leave those cells no
+ * other candidates
+*/
+
+static int useHidden(sheet *s, int u, unsigned items, unsigned cover, logic_step *step) {
+    int eliminated = 0;
+    for(int k = 0; k < N; k++) {
+        if(!(cover >> k & 1)) {
+            continue;
+        }
+        int i = unitCell(u, k);
+        for(int d = 1; d <= N; d++) {
+            if(!(items >> (d - 1) & 1)) {
+                eliminated += eliminate(s, i, d);
+            }
+        }
+    }
+    step->unit = u;
+    step->cells = cover;
+    step->digits = items << 1;
+    step->eliminated = eliminated;
+    return eliminated > 0;
+}
+
+static int hidden(sheet *s, int size, logic_step *step) {
+    for(int u = 0; u < 3 * N; u++) {
+        unsigned masks[N];
+        for(int d = 1; d <= N; d++) {
+            masks[d - 1] = (__builtin_popcount(s->where[u][d]) >= 2) ? s->where[u][d] : 0;
+        }
+        if(subsets(s, u, masks, size, 0, 0, 0, useHidden, step)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Fish (X-wings, swordfish): if a digit fits in only size columns (cover)
+ * of size rows (items), those rows take the digit in every one of those
+ * columns, so the columns' other rows can't; likewise with rows and
+ * columns swapped. Here u is the digit, plus N * N if the base lines are
+ * columns
+*/
+
+static int useFish(sheet *s, int u, unsigned items, unsigned cover, logic_step *step) {
+    int d = u % (N * N), columns = u >= N * N;
+    int eliminated = 0;
+    for(int a = 0; a < N; a++) {
+        if(!(cover >> a & 1)) {
+            continue;
+        }
+        for(int b = 0; b < N; b++) {
+            int i = columns ? a * N + b : b * N + a;
+            if(!(items >> b & 1) && s->cell[i] == 0) {
+                eliminated += eliminate(s, i, d);
+            }
+        }
+    }
+    step->unit = columns ? N : 0;
+    step->digit = d;
+    step->cells = items;
+    step->cover = cover;
+    step->eliminated = eliminated;
+    return eliminated > 0;
+}
+
+static int fish(sheet *s, int size, logic_step *step) {
+    for(int columns = 0; columns < 2; columns++) {
+        for(int d = 1; d <= N; d++) {
+            unsigned masks[N];
+            for(int k = 0; k < N; k++) {
+                unsigned w = s->where[columns * N + k][d];
+                masks[k] = (__builtin_popcount(w) >= 2) ? w : 0;
+            }
+            if(subsets(s, columns * N * N + d, masks, size, 0, 0, 0, useFish, step)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Makes the next deduction, with the easiest technique that makes one.
+ * Returns 0 if there's none (or the board is solved or broken)
+*/
+
+static int deduce(sheet *s, logic_step *step) {
+    memset(step, 0, sizeof(logic_step));
+    step->cell = -1;
+    if(s->left == 0 || s->broken) {
+        return 0;
+    }
+    for(int t = 0; t < TECHNIQUES; t++) {
+        int found = 0;
+        switch(t) {
+            case TECH_NAKED_SINGLE: found = nakedSingle(s, step); break;
+            case TECH_HIDDEN_SINGLE: found = hiddenSingle(s, step); break;
+            case TECH_POINTING: found = pointing(s, step); break;
+            case TECH_CLAIMING: found = claiming(s, step); break;
+            case TECH_NAKED_PAIR: found = naked(s, 2, step); break;
+            case TECH_HIDDEN_PAIR: found = hidden(s, 2, step); break;
+            case TECH_NAKED_TRIPLE: found = naked(s, 3, step); break;
+            case TECH_HIDDEN_TRIPLE: found = hidden(s, 3, step); break;
+            case TECH_X_WING: found = fish(s, 2, step); break;
+            case TECH_SWORDFISH: found = fish(s, 3, step); break;
+        }
+        if(found) {
+            step->technique = t;
+            return !s->broken;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Solves the board in place as far as logic goes, counting the steps of
+ * each technique into used unless it's NULL. Returns the hardest TECH_* it
+ * needed, or TECHNIQUES if logic alone can't finish it (it takes guessing,
+ * or has no solution)
+*/
+
+int gradeLogic(int board[N][N], int used[TECHNIQUES]) {
+
+    sheet s;
+    if(!load(&s, board)) {
+        return TECHNIQUES;
+    }
+
+    int hardest = TECH_NAKED_SINGLE;
+    logic_step step;
+    while(deduce(&s, &step)) {
+        if(step.technique > hardest) {
+            hardest = step.technique;
+        }
+        if(used != NULL) {
+            used[step.technique]++;
+        }
+    }
+
+    for(int i = 0; i < CELLS; i++) {
+        board[i / N][i % N] = s.cell[i];
+    }
+    return (s.left == 0 && !s.broken) ? hardest : TECHNIQUES;
+}
+
+/*
+ * Finds a deduction logic can make on the board into hint: the first one
+ * after skip deductions that only eliminate candidates, or the first digit
+ * placed if that comes sooner (so hints go step by step, eliminations
+ * included, towards the next digit). Returns 0 if there's none
+*/
+
+int hintLogic(int board[N][N], int skip, logic_step *hint) {
+
+    sheet s;
+    if(!load(&s, board) || s.broken) {
+        return 0;
+    }
+    while(deduce(&s, hint)) {
+        if(hint->cell >= 0 || skip-- == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *techniqueName(int technique) {
+
+    return (technique >= 0 && technique < TECHNIQUES) ? names[technique] : "guessing";
+}
+
+/*
+ * Appends to text, if there's room
+*/
+
+static void append(char *text, size_t size, const char *fmt, ...) {
+    size_t used = strlen(text);
+    if(used + 1 >= size) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(text + used, size - used, fmt, ap);
+    va_end(ap);
+}
+
+static void unitText(char *text, size_t size, int u) {
+    if(u < N) {
+        append(text, size, "row %d", u + 1);
+    } else if(u < 2 * N) {
+        append(text, size, "column %d", u - N + 1);
+    } else {
+        append(text, size, "box %d", u - 2 * N + 1);
+    }
+}
+
+/*
+ * Appends the members of set: cells of unit u as r#c#, or digits, or line numbers
+*/
+
+static void setText(char *text, size_t size, unsigned set, int u, int digits) {
+    int n = 0, count = __builtin_popcount(set);
+    for(int k = 0; k < N + 1; k++) {
+        if(!(set >> k & 1)) {
+            continue;
+        }
+        append(text, size, "%s", (n == 0) ? "" : (n == count - 1) ? " and " : ", ");
+        if(u >= 0) {
+            int i = unitCell(u, k);
+            append(text, size, "r%dc%d", i / N + 1, i % N + 1);
+        } else if(digits) {
+            append(text, size, "%c", SYMBOLS[k - 1]);
+        } else {
+            append(text, size, "%d", k + 1);
+        }
+        n++;
+    }
+}
+
+/*
+ * Writes what step deduced, in words, into text
+*/
+
+void explainStep(const logic_step *step, char *text, size_t size) {
+
+    if(size == 0) {
+        return;
+    }
+    text[0] = '\0';
+    int i = step->cell, d = step->digit;
+    switch(step->technique) {
+        case TECH_NAKED_SINGLE:
+            append(text, size, "r%dc%d can only be %c", i / N + 1, i % N + 1, SYMBOLS[d - 1]);
+            break;
+        case TECH_HIDDEN_SINGLE:
+            append(text, size, "%c can only go in r%dc%d within ", SYMBOLS[d - 1], i / N + 1, i % N + 1);
+            unitText(text, size, step->unit);
+            break;
+        case TECH_POINTING:
+        case TECH_CLAIMING:
+            append(text, size, "in ");
+            unitText(text, size, step->unit);
+            append(text, size, ", %c is only in ", SYMBOLS[d - 1]);
+            unitText(text, size, step->cover);
+            append(text, size, ", so nowhere else in ");
+            unitText(text, size, step->cover);
+            break;
+        case TECH_NAKED_PAIR:
+        case TECH_NAKED_TRIPLE:
+            setText(text, size, step->cells, step->unit, 0);
+            append(text, size, " hold only ");
+            setText(text, size, step->digits, -1, 1);
+            append(text, size, ", so no other cell of ");
+            unitText(text, size, step->unit);
+            append(text, size, " can hold them");
+            break;
+        case TECH_HIDDEN_PAIR:
+        case TECH_HIDDEN_TRIPLE:
+            append(text, size, "in ");
+            unitText(text, size, step->unit);
+            append(text, size, ", ");
+            setText(text, size, step->digits, -1, 1);
+            append(text, size, " fit only in ");
+            setText(text, size, step->cells, step->unit, 0);
+            append(text, size, ", which take nothing else");
+            break;
+        case TECH_X_WING:
+        case TECH_SWORDFISH:
+            append(text, size, "%c fits only in %s ", SYMBOLS[d - 1], step->unit ? "rows" : "columns");
+            setText(text, size, step->cover, -1, 0);
+            append(text, size, " of %s ", step->unit ? "columns" : "rows");
+            setText(text, size, step->cells, -1, 0);
+            append(text, size, ", so nowhere else in those %s", step->unit ? "rows" : "columns");
+            break;
+    }
+    append(text, size, " (%s)", techniqueName(step->technique));
+}
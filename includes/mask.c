@@ -0,0 +1,318 @@
+/*
+ * Constraint-propagation solver engine.
+ *
+ * Keeps an N-bit mask of the digits already used in every row, column and
+ * square, so a cell's candidates are one OR away instead of a 3N-cell scan.
+ * Naked and hidden singles are placed before any guess is made, and when
+ * a guess is needed it's made on the cell with the fewest candidates.
+*/
+
+#include <stddef.h>
+#include "puzzle.h"
+
+// bits 1 to N set, one per digit
+#define ALL ((digit_mask) ((1u << (N + 1)) - 2))
+
+// square of cell i (cells are numbered 0 to CELLS - 1, row by row)
+#define SQUARE(i) (((i) / (N * BOX)) * BOX + ((i) % N) / BOX)
+
+// state of a board while it's being solved
+typedef struct {
+    // digits used in each row, column and square
+    digit_mask row[N], col[N], square[N];
+
+    // the board's cells, 0 if empty
+    unsigned char cell[CELLS];
+
+    // number of empty cells
+    int left;
+} grid;
+
+
+/*
+ * Returns the candidates (as a mask) of the empty cell i
+*/
+
+static inline digit_mask candidates(const grid *g, int i) {
+    return ~(g->row[i / N] | g->col[i % N] | g->square[SQUARE(i)]) & ALL;
+}
+
+/*
+ * Writes num into the empty cell i and updates the masks
+*/
+
+static inline void place(grid *g, int i, int num) {
+    digit_mask bit = 1u << num;
+
+    g->cell[i] = num;
+    g->row[i / N] |= bit;
+    g->col[i % N] |= bit;
+    g->square[SQUARE(i)] |= bit;
+    g->left--;
+}
+
+/*
+ * Returns the k-th cell (0 to N - 1) of unit u: rows are 0 to N - 1, columns
+ * N to 2N - 1, squares 2N to 3N - 1
+*/
+
+static inline int unitCell(int u, int k) {
+    if(u < N) {
+        return u * N + k;
+    } else if(u < 2 * N) {
+        return k * N + (u - N);
+    } else {
+        u -= 2 * N;
+        return ((u / BOX) * BOX + k / BOX) * N + (u % BOX) * BOX + k % BOX;
+    }
+}
+
+/*
+ * Places every naked and hidden single until none is left.
+ * Returns 0 if the board turns out to be impossible
+*/
+
+static int propagate(grid *g) {
+
+    int changed = 1;
+
+    while(changed) {
+        changed = 0;
+
+        // naked singles: cells with a single candidate
+        for(int i = 0; i < CELLS; i++) {
+            if(g->cell[i] != 0) {
+                continue;
+            }
+            digit_mask cand = candidates(g, i);
+            if(cand == 0) {
+                return 0;
+            }
+            if((cand & (cand - 1)) == 0) {
+                place(g, i, __builtin_ctz(cand));
+                changed = 1;
+            }
+        }
+
+        if(changed || g->left == 0) {
+            continue;
+        }
+
+        // hidden singles: digits that fit in a single cell of a unit
+        for(int u = 0; u < 3 * N; u++) {
+            digit_mask once = 0, twice = 0, used = 0;
+
+            for(int k = 0; k < N; k++) {
+                int i = unitCell(u, k);
+                if(g->cell[i] != 0) {
+                    used |= 1u << g->cell[i];
+                } else {
+                    digit_mask cand = candidates(g, i);
+                    twice |= once & cand;
+                    once |= cand;
+                }
+            }
+
+            // a digit with nowhere to go
+            if((once | used) != ALL) {
+                return 0;
+            }
+
+            digit_mask hidden = once & ~twice;
+            while(hidden) {
+                int num = __builtin_ctz(hidden);
+                hidden &= hidden - 1;
+
+                // find the digit's cell again, an earlier placement may have taken it
+                int found = -1;
+                for(int k = 0; k < N; k++) {
+                    int i = unitCell(u, k);
+                    if(g->cell[i] == 0 && (candidates(g, i) & (1u << num))) {
+                        found = i;
+                        break;
+                    }
+                }
+                if(found < 0) {
+                    return 0;
+                }
+                place(g, found, num);
+                changed = 1;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Returns the empty cell with the fewest candidates (stopping early at two)
+*/
+
+static int mostConstrained(const grid *g, solve_stats *stats) {
+
+    int best = -1;
+    int fewest = N + 1;
+    for(int i = 0; i < CELLS && fewest > 2; i++) {
+        if(g->cell[i] == 0) {
+            STAT_ADD(stats, tests, 1);
+            int n = __builtin_popcount(candidates(g, i));
+            if(n < fewest) {
+                fewest = n;
+                best = i;
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * Propagates, then guesses on the most constrained cell and recurses on a copy
+*/
+
+static int search(grid *g, int depth, solve_stats *stats) {
+
+    if((stats != NULL && ++stats->calls > stats->limit && stats->limit > 0) || CANCELLED(stats)) {
+        return 0;
+    }
+    STAT_DEPTH(stats, depth);
+    if(!propagate(g)) {
+        return 0;
+    }
+    if(g->left == 0) {
+        return 1;
+    }
+
+    int best = mostConstrained(g, stats);
+
+    digit_mask cand = candidates(g, best);
+    while(cand) {
+        int num = __builtin_ctz(cand);
+        cand &= cand - 1;
+
+        grid next = *g;
+        place(&next, best, num);
+        if(stats != NULL) {
+            stats->guesses++;
+        }
+        if(search(&next, depth + 1, stats)) {
+            *g = next;
+            return 1;
+        }
+        STAT_ADD(stats, backtracks, 1);
+    }
+    return 0;
+}
+
+/*
+ * Counts solutions below g, stopping once cap have been found
+*/
+
+static int count(grid *g, int cap, int depth, solve_stats *stats) {
+
+    // out of calls: as good as several solutions
+    if(stats != NULL && ++stats->calls > stats->limit && stats->limit > 0) {
+        return cap;
+    }
+    if(CANCELLED(stats)) {
+        return 0;
+    }
+    STAT_DEPTH(stats, depth);
+    if(!propagate(g)) {
+        return 0;
+    }
+    if(g->left == 0) {
+        return 1;
+    }
+
+    int best = mostConstrained(g, stats);
+
+    int found = 0;
+    digit_mask cand = candidates(g, best);
+    while(cand && found < cap) {
+        int num = __builtin_ctz(cand);
+        cand &= cand - 1;
+
+        grid next = *g;
+        place(&next, best, num);
+        if(stats != NULL) {
+            stats->guesses++;
+        }
+        found += count(&next, cap - found, depth + 1, stats);
+    }
+    return found;
+}
+
+/*
+ * Loads the board's givens into g. Returns 0 if they already conflict
+*/
+
+static int load(grid *g, int board[N][N]) {
+
+    for(int i = 0; i < CELLS; i++) {
+        int num = board[i / N][i % N];
+        if(num == 0) {
+            continue;
+        }
+        if(num < 0 || num > N || !(candidates(g, i) & (1u << num))) {
+            return 0;
+        }
+        place(g, i, num);
+    }
+    return 1;
+}
+
+/*
+ * Solves the board in place. Returns 1 if solved, 0 if there's no solution
+ * (or the givens already conflict), in which case the board is left untouched.
+ * Counts into stats unless it's NULL, and gives up (returning 0) after
+ * stats->limit calls if that's set, or once *stats->cancel (or *stats->outer) is
+*/
+
+int solveMask(int board[N][N], solve_stats *stats) {
+
+    grid g = { .left = CELLS };
+
+    if(!load(&g, board) || !search(&g, 1, stats)) {
+        return 0;
+    }
+
+    for(int i = 0; i < CELLS; i++) {
+        board[i / N][i % N] = g.cell[i];
+    }
+    return 1;
+}
+
+/*
+ * Returns how many solutions the board has, counting no further than cap
+ * (so cap 2 tells none, unique and several apart), or cap if it runs out of
+ * stats->limit calls first (and what it has counted so far once
+ * *stats->cancel is set). The board isn't changed
+*/
+
+int countMask(int board[N][N], int cap, solve_stats *stats) {
+
+    grid g = { .left = CELLS };
+
+    if(cap < 1 || !load(&g, board)) {
+        return 0;
+    }
+    return count(&g, cap, 1, stats);
+}
+
+/*
+ * Fills in every naked and hidden single of the board, in place. Returns 0
+ * if the board turns out to have no solution (it's then left untouched)
+*/
+
+int propagateMask(int board[N][N]) {
+
+    grid g = { .left = CELLS };
+
+    if(!load(&g, board) || !propagate(&g)) {
+        return 0;
+    }
+
+    for(int i = 0; i < CELLS; i++) {
+        board[i / N][i % N] = g.cell[i];
+    }
+    return 1;
+}
@@ -0,0 +1,273 @@
+/*
+ * Buffered move log
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "movelog.h"
+#include "session.h"
+
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * Appends bytes to the buffer, writing it out first if they don't fit
+*/
+
+static void append(movelog *l, const unsigned char *bytes, size_t n) {
+    if(l->used + n > LOG_BUFFER) {
+        movelog_flush(l);
+    }
+    memcpy(l->buffer + l->used, bytes, n);
+    l->used += n;
+}
+
+static void record(movelog *l, int ch, int cell, int value) {
+    unsigned char bytes[LOG_RECORD] = { ch & 0xFF, (ch >> 8) & 0xFF };
+    for(int i = 0; i < LOG_CELL; i++) {
+        bytes[2 + i] = cell >> (8 * i);
+    }
+    bytes[2 + LOG_CELL] = value;
+    append(l, bytes, LOG_RECORD);
+}
+
+int movelog_open(movelog *l, const char *path) {
+    l->used = 0;
+    l->flushed = now();
+
+    // runs add up, so a log that's grown too big makes way for a new one
+    struct stat st;
+    if(stat(path, &st) == 0 && st.st_size >= LOG_LIMIT) {
+        char old[strlen(path) + 3];
+        sprintf(old, "%s.1", path);
+        rename(path, old);
+    }
+
+    l->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    l->failed = l->fd < 0;
+    return l->fd >= 0;
+}
+
+void movelog_start(movelog *l, int level, int number, const compact_board *board) {
+    if(l->fd < 0) {
+        return;
+    }
+
+    // the game's header follows the previous games' records
+    unsigned char header[LOG_HEADER] = { 0 };
+    memcpy(header, LOG_MAGIC, 4);
+    header[4] = LOG_VERSION;
+    header[5] = level;
+    header[6] = BOX;
+    for(int i = 0; i < 4; i++) {
+        header[8 + i] = (unsigned) number >> (8 * i);
+    }
+    append(l, header, LOG_HEADER);
+
+    l->board = *board;
+    append(l, l->board.cell, CELLS);
+}
+
+void movelog_key(movelog *l, int ch, const compact_board *board) {
+    if(l->fd < 0) {
+        return;
+    }
+
+    // one record per changed cell, the first one carrying the key (most
+    // keys change nothing, which one memcmp tells)
+    int changed = 0;
+    int same = memcmp(&l->board, board, sizeof(compact_board)) == 0;
+    for(int i = 0; i < CELLS && !same; i++) {
+        int value = board->cell[i];
+        if(value != l->board.cell[i]) {
+            record(l, changed ? LOG_MORE : ch, i, value);
+            l->board.cell[i] = value;
+            changed = 1;
+        }
+    }
+    if(!changed) {
+        record(l, ch, LOG_NONE, 0);
+    }
+
+    movelog_poll(l);
+}
+
+void movelog_poll(movelog *l) {
+    if(l->used > 0 && now() - l->flushed >= LOG_INTERVAL) {
+        movelog_flush(l);
+    }
+}
+
+void movelog_flush(movelog *l) {
+    size_t done = 0;
+    while(l->fd >= 0 && done < l->used) {
+        ssize_t n = write(l->fd, l->buffer + done, l->used - done);
+        if(n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    if(done < l->used) {
+        l->failed = 1;
+    }
+    l->used = 0;
+    l->flushed = now();
+}
+
+int movelog_close(movelog *l) {
+    if(l->fd >= 0) {
+        movelog_flush(l);
+        if(close(l->fd) != 0) {
+            l->failed = 1;
+        }
+        l->fd = -1;
+    }
+    return !l->failed;
+}
+
+/*
+ * Reads the whole file at path into a new buffer; returns NULL on failure
+*/
+
+static unsigned char *slurp(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    unsigned char *data = NULL;
+    if(fstat(fd, &st) == 0 && st.st_size > 0 && (data = malloc(st.st_size)) != NULL) {
+        size_t done = 0;
+        ssize_t n = 1;
+        while(done < (size_t) st.st_size && (n = read(fd, data + done, st.st_size - done)) > 0) {
+            done += n;
+        }
+        if(done < (size_t) st.st_size) {
+            free(data);
+            data = NULL;
+        }
+        *size = done;
+    }
+    close(fd);
+    return data;
+}
+
+/*
+ * Returns 1 if a game's header starts at data (length bytes left), reading
+ * its board number and starting board; 0 if something else does, and -1 if
+ * it's the header of another version or board size
+*/
+
+static int header(const unsigned char *data, size_t length, int *number, compact_board *start) {
+    if(length < LOG_HEADER + CELLS || memcmp(data, LOG_MAGIC, 4) != 0) {
+        return 0;
+    }
+    int box = (data[6] != 0) ? data[6] : 3;
+    if(data[4] < 1 || data[4] > LOG_VERSION || box != BOX) {
+        return -1;
+    }
+
+    *number = 0;
+    for(int i = 0; i < 4; i++) {
+        *number |= data[8 + i] << (8 * i);
+    }
+    memcpy(start->cell, data + LOG_HEADER, CELLS);
+    return 1;
+}
+
+int movelog_replay(const char *path, long *keys, char *why, size_t size) {
+    *keys = 0;
+    size_t length;
+    unsigned char *data = slurp(path, &length);
+    if(data == NULL) {
+        snprintf(why, size, "can't be read");
+        return -1;
+    }
+
+    // the first game's header, for a board of this size
+    int number;
+    compact_board start;
+    if(header(data, length, &number, &start) != 1) {
+        snprintf(why, size, "not a move log of %dx%d boards", N, N);
+        free(data);
+        return -1;
+    }
+
+    session game;
+    int games = 0;
+
+    int ok = 1;
+    size_t at = 0;
+    while(ok && at + LOG_RECORD <= length) {
+
+        // every game starts over from its header
+        int found = header(data + at, length - at, &number, &start);
+        if(found < 0) {
+            snprintf(why, size, "game at byte %zu isn't of %dx%d boards", at, N, N);
+            ok = 0;
+            break;
+        }
+        if(found) {
+            session_start(&game, number, &start);
+            games++;
+            at += LOG_HEADER + CELLS;
+            continue;
+        }
+
+        int ch = data[at] | data[at + 1] << 8;
+        if(ch == LOG_MORE) {
+            snprintf(why, size, "record at byte %zu continues no keypress", at);
+            ok = 0;
+            break;
+        }
+
+        // what the keypress logged: its record and any LOG_MORE after it
+        compact_board before = game.board, logged = game.board;
+        do {
+            int cell = 0;
+            for(int i = 0; i < LOG_CELL; i++) {
+                cell |= data[at + 2 + i] << (8 * i);
+            }
+            if(cell != LOG_NONE && cell < CELLS) {
+                logged.cell[cell] = data[at + 2 + LOG_CELL];
+            }
+            at += LOG_RECORD;
+        } while(at + LOG_RECORD <= length && (data[at] | data[at + 1] << 8) == LOG_MORE);
+
+        // N and R are logged after the header of the game they start
+        if(ch == 'N' || ch == 'R') {
+            session_start(&game, number, &start);
+        } else {
+            session_key(&game, ch);
+        }
+        (*keys)++;
+
+        if(memcmp(&game.board, &logged, sizeof(compact_board)) != 0) {
+            int i = 0;
+            while(game.board.cell[i] == logged.cell[i]) {
+                i++;
+            }
+            snprintf(why, size, "game %d, keypress #%ld (key %d) at (%d, %d): cell (%d, %d) was %d, logged %d, replayed %d",
+                     games, *keys, ch, game.y, game.x, i / N, i % N, before.cell[i], logged.cell[i], game.board.cell[i]);
+            ok = 0;
+        }
+    }
+    if(ok && at != length) {
+        snprintf(why, size, "ends in the middle of a record");
+        ok = 0;
+    }
+
+    free(data);
+    return ok;
+}
@@ -0,0 +1,93 @@
+/****************************************************************************
+ * movelog.h
+ *
+ * Buffered log of a game's moves, to facilitate automated tests.
+ *
+ * A log holds every game played since it was created, one after the
+ * other. A game starts with a LOG_HEADER-byte header (magic "SDKM",
+ * version, level, box size, board number) and the board's CELLS cells as
+ * one byte each. Then every keypress is a LOG_RECORD-byte record: the
+ * keycode (16 bits, little-endian), the cell it changed (0 to CELLS - 1,
+ * LOG_NONE if none; LOG_CELL bytes, little-endian) and the cell's new
+ * value. A keypress that changed several cells is followed by LOG_MORE
+ * records, one per extra cell. No keycode starts with the magic's bytes,
+ * so the next game's header can't be mistaken for a record.
+ *
+ * Version 1 logs (a single game each) are still replayed.
+ ***************************************************************************/
+
+#ifndef MOVELOG_H
+#define MOVELOG_H
+
+#include <stddef.h>
+#include "sudoku.h"
+
+// log's magic, version and sizes (in bytes)
+#define LOG_MAGIC "SDKM"
+#define LOG_VERSION 2
+#define LOG_HEADER 16
+
+// bytes of a record's cell (two only for boards of 255 cells or more), and
+// the cell of a record that changed nothing
+#if CELLS < 255
+#define LOG_CELL 1
+#define LOG_NONE 255
+#else
+#define LOG_CELL 2
+#define LOG_NONE 0xFFFF
+#endif
+#define LOG_RECORD (3 + LOG_CELL)
+
+// keycode of an extra cell's record
+#define LOG_MORE 0xFFFF
+
+// bytes buffered, and seconds between flushes, before writing to disk
+#define LOG_BUFFER 65536
+#define LOG_INTERVAL 1.0
+
+// size (in bytes) past which opening a log moves it aside, to PATH.1
+// (replacing the one there), and starts a new one
+#define LOG_LIMIT (64L << 20)
+
+typedef struct {
+    int fd;
+
+    // records not yet written
+    unsigned char buffer[LOG_BUFFER];
+    size_t used;
+
+    // board as of the last record
+    compact_board board;
+
+    // when the buffer was last written (in seconds), and set once a write
+    // (or opening the log) has failed
+    double flushed;
+    int failed;
+} movelog;
+
+// opens the log at path, games being added after those it holds (unless
+// it's over LOG_LIMIT); returns 0 on failure
+int movelog_open(movelog *l, const char *path);
+
+// starts a new game on this board in the log
+void movelog_start(movelog *l, int level, int number, const compact_board *board);
+
+// records a keypress and whatever it changed on board
+void movelog_key(movelog *l, int ch, const compact_board *board);
+
+// writes the buffer out if it's older than LOG_INTERVAL
+void movelog_poll(movelog *l);
+
+// writes the buffer out
+void movelog_flush(movelog *l);
+
+// flushes and closes the log; returns 0 if anything failed to be written
+int movelog_close(movelog *l);
+
+// plays every game of the log at path again on a headless session, checking
+// that every keypress changes the board as logged; returns 1 if all do, 0
+// (describing the first that doesn't in why) if not, -1 if the log can't be
+// read. *keys is the number of keypresses replayed
+int movelog_replay(const char *path, long *keys, char *why, size_t size);
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * Parallel solver engine.
+ *
+ * Splits one board's search tree at its first few branching cells (the
+ * most constrained ones once singles are filled in, as the mask engine
+ * would pick them) into branches, and hands each branch to the mask engine as a task on the
+ * shared pool (see pool.h). The first branch to find a solution calls the others
+ * off through a shared flag; when counting, branches add up their counts
+ * and call the rest off once the cap is reached.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include "pool.h"
+#include "puzzle.h"
+
+// branches to aim for per worker, so idle workers have something to steal
+#define SPLIT 8
+
+// most branches a board is split into
+#define BRANCHES 256
+
+// calls the mask engine gets on a board alone before the board is split
+#define ALONE 256
+
+// square of cell i (cells are numbered 0 to CELLS - 1, row by row)
+#define SQUARE(i) (((i) / (N * BOX)) * BOX + ((i) % N) / BOX)
+
+typedef struct job job;
+
+// a subtree of the search: the board with the cells branched on filled in
+typedef struct {
+    job *job;
+    int board[N][N];
+    solve_stats stats;
+} branch;
+
+// one board being solved (or counted) by its branches
+struct job {
+    branch *branches;
+    int count;
+
+    // solutions to count up to (0 when solving), and found so far
+    int cap;
+    int found;
+
+    // the branch whose board is solved (-1 if none yet), and set to call
+    // every other branch off
+    int winner;
+    int cancel;
+};
+
+
+/*
+ * Finds the empty cell of board with the fewest candidates. Returns the
+ * cell, with its candidates in *cand, or -1 if the board is full (or a
+ * cell has none, in which case *cand is 0)
+*/
+
+static int branchCell(int board[N][N], digit_mask *cand) {
+
+    digit_mask rows[N] = { 0 }, cols[N] = { 0 }, squares[N] = { 0 };
+    for(int i = 0; i < CELLS; i++) {
+        int num = board[i / N][i % N];
+        if(num != 0) {
+            rows[i / N] |= 1u << num;
+            cols[i % N] |= 1u << num;
+            squares[SQUARE(i)] |= 1u << num;
+        }
+    }
+
+    int best = -1, fewest = N + 1;
+    *cand = 1;
+    for(int i = 0; i < CELLS && fewest > 0; i++) {
+        if(board[i / N][i % N] == 0) {
+            digit_mask c = ~(rows[i / N] | cols[i % N] | squares[SQUARE(i)]) & ((1u << (N + 1)) - 2);
+            int n = __builtin_popcount(c);
+            if(n < fewest) {
+                fewest = n;
+                best = i;
+                *cand = c;
+            }
+        }
+    }
+    return (fewest == 0) ? -1 : best;
+}
+
+/*
+ * Splits board into up to BRANCHES branches (at least target if the tree
+ * is that wide), breadth first. Returns how many (0 if the board has no
+ * solution), or -1 if out of memory
+*/
+
+static int split(job *j, int board[N][N], int target) {
+
+    j->branches = malloc(BRANCHES * sizeof(branch));
+    if(j->branches == NULL) {
+        return -1;
+    }
+    memcpy(j->branches[0].board, board, sizeof(j->branches[0].board));
+    int count = 1;
+
+    // branch on the next board in turn, its first child taking its place
+    int next = 0, stuck = 0;
+    while(count > 0 && count < target && stuck < count) {
+        branch *b = &j->branches[next];
+
+        // fill in what's forced first, so that only real choices are
+        // branched on; a board that turns out impossible is dropped
+        if(!propagateMask(b->board)) {
+            memcpy(b->board, j->branches[--count].board, sizeof(b->board));
+            next = (next < count) ? next : 0;
+            stuck = 0;
+            continue;
+        }
+
+        digit_mask cand;
+        int cell = branchCell(b->board, &cand);
+        int children = __builtin_popcount(cand);
+        if(cell < 0 || children < 2 || count + children - 1 > BRANCHES) {
+            next = (next + 1) % count;
+            stuck++;
+            continue;
+        }
+
+        int first = __builtin_ctz(cand);
+        for(int k = 1; k < children; k++) {
+            cand &= cand - 1;
+            branch *child = &j->branches[count++];
+            memcpy(child->board, b->board, sizeof(child->board));
+            child->board[cell / N][cell % N] = __builtin_ctz(cand);
+        }
+        b->board[cell / N][cell % N] = first;
+        stuck = 0;
+        next = (next + 1) % count;
+    }
+    return count;
+}
+
+/*
+ * Adds the counters of from to stats (depths being below the split)
+*/
+
+static void addStats(solve_stats *stats, const solve_stats *from) {
+    stats->calls += from->calls;
+    stats->guesses += from->guesses;
+    stats->tests += from->tests;
+    stats->backtracks += from->backtracks;
+    if(from->depth > stats->depth) {
+        stats->depth = from->depth;
+    }
+}
+
+/*
+ * Task: solves (or counts) one branch, unless another branch already settled it
+*/
+
+static void run(void *arg) {
+    branch *b = arg;
+    job *j = b->job;
+
+    if(j->cap == 0) {
+        if(solveMask(b->board, &b->stats)) {
+            int none = -1;
+            if(__atomic_compare_exchange_n(&j->winner, &none, (int) (b - j->branches), 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                __atomic_store_n(&j->cancel, 1, __ATOMIC_RELAXED);
+            }
+        }
+    } else {
+        int found = countMask(b->board, j->cap, &b->stats);
+        if(__atomic_add_fetch(&j->found, found, __ATOMIC_ACQ_REL) >= j->cap) {
+            __atomic_store_n(&j->cancel, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*
+ * Splits board, runs its branches on the pool and waits for them all.
+ * Returns 0 if it couldn't, leaving j without branches
+*/
+
+static int spread(job *j, int board[N][N], int cap, solve_stats *stats) {
+
+    pool *workers = pool_shared();
+    if(workers == NULL) {
+        return 0;
+    }
+
+    *j = (job) { .cap = cap, .winner = -1 };
+    j->count = split(j, board, SPLIT * pool_size(workers));
+    if(j->count < 0) {
+        return 0;
+    }
+
+    // the caller may be a worker itself (e.g. a batch chunk's), which then
+    // runs branches while it waits
+    future done;
+    future_init(&done);
+    for(int i = 0; i < j->count; i++) {
+        branch *b = &j->branches[i];
+        b->job = j;
+        b->stats = (solve_stats) {
+            .limit = (stats != NULL) ? stats->limit : 0,
+            .cancel = &j->cancel,
+            .outer = (stats != NULL) ? stats->cancel : NULL,
+        };
+        pool_async(workers, &done, run, b);
+    }
+    future_wait(&done);
+    future_destroy(&done);
+
+    for(int i = 0; stats != NULL && i < j->count; i++) {
+        addStats(stats, &j->branches[i].stats);
+    }
+    return 1;
+}
+
+/*
+ * Solves the board in place, like solveMask but on all cores. Returns 1 if
+ * solved, 0 if there's no solution (the board is then left untouched)
+*/
+
+int solveParallel(int board[N][N], solve_stats *stats) {
+
+    // most boards take a few calls: only the ones that outlast those are split
+    int copy[N][N];
+    memcpy(copy, board, sizeof(copy));
+    solve_stats alone = { .limit = ALONE, .cancel = (stats != NULL) ? stats->cancel : NULL };
+    int solved = solveMask(copy, &alone);
+    if(stats != NULL) {
+        addStats(stats, &alone);
+    }
+    if(solved || alone.calls <= ALONE || CANCELLED(stats)) {
+        if(solved) {
+            memcpy(board, copy, sizeof(copy));
+        }
+        return solved;
+    }
+
+    job j;
+    if(!spread(&j, board, 0, stats)) {
+        return solveMask(board, stats);
+    }
+
+    solved = j.winner >= 0;
+    if(solved) {
+        memcpy(board, j.branches[j.winner].board, sizeof(j.branches[j.winner].board));
+    }
+    free(j.branches);
+    return solved;
+}
+
+/*
+ * Returns how many solutions the board has, counting no further than cap,
+ * like countMask but on all cores. The board isn't changed
+*/
+
+int countParallel(int board[N][N], int cap, solve_stats *stats) {
+
+    if(cap < 1) {
+        return 0;
+    }
+
+    // as when solving, only the boards that outlast a few calls are split
+    solve_stats alone = { .limit = ALONE, .cancel = (stats != NULL) ? stats->cancel : NULL };
+    int found = countMask(board, cap, &alone);
+    if(stats != NULL) {
+        addStats(stats, &alone);
+    }
+    if(alone.calls <= ALONE || CANCELLED(stats)) {
+        return found;
+    }
+
+    job j;
+    if(!spread(&j, board, cap, stats)) {
+        return countMask(board, cap, stats);
+    }
+
+    free(j.branches);
+    return (j.found < cap) ? j.found : cap;
+}
@@ -0,0 +1,340 @@
+/*
+ * Work-stealing thread pool
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+typedef struct {
+    task_fn fn;
+    void *arg;
+
+    // the future the task belongs to, if any
+    future *future;
+} task;
+
+// a worker's deque: the owner works at the tail, thieves at the head
+typedef struct {
+    pthread_mutex_t lock;
+    task *tasks;
+    int capacity;
+    int head, tail;
+} deque;
+
+typedef struct {
+    pool *owner;
+    int id;
+    deque queue;
+    pthread_t thread;
+} worker;
+
+struct pool {
+    worker *workers;
+    int size;
+
+    // where tasks submitted from outside the pool go next
+    unsigned next;
+
+    // guards sleeping and waiting
+    pthread_mutex_t lock;
+    pthread_cond_t work, done;
+
+    // tasks sitting in deques, and tasks not yet finished
+    int queued;
+    int pending;
+
+    int stop;
+};
+
+// the worker running on this thread, if any
+static __thread worker *self;
+
+// the process's pool, started on first use
+static pool *shared;
+static pthread_once_t sharing = PTHREAD_ONCE_INIT;
+
+
+/*
+ * Appends a task at the deque's tail, growing it if full. Returns 0 if out
+ * of memory, leaving the deque as it was
+*/
+
+static int push(deque *d, task t) {
+    pthread_mutex_lock(&d->lock);
+    if(d->tail - d->head == d->capacity) {
+        int capacity = d->capacity ? d->capacity * 2 : 64;
+        task *tasks = malloc(capacity * sizeof(task));
+        if(tasks == NULL) {
+            pthread_mutex_unlock(&d->lock);
+            return 0;
+        }
+        for(int i = d->head; i < d->tail; i++) {
+            tasks[i - d->head] = d->tasks[i % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = tasks;
+        d->tail -= d->head;
+        d->head = 0;
+        d->capacity = capacity;
+    }
+    d->tasks[d->tail % d->capacity] = t;
+    d->tail++;
+    pthread_mutex_unlock(&d->lock);
+    return 1;
+}
+
+/*
+ * Takes the newest task (owner) or the oldest one (thief). Returns 0 if empty
+*/
+
+static int take(deque *d, task *t, int newest) {
+    int found = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if(d->tail > d->head) {
+        if(newest) {
+            d->tail--;
+            *t = d->tasks[d->tail % d->capacity];
+        } else {
+            *t = d->tasks[d->head % d->capacity];
+            d->head++;
+        }
+        if(d->head == d->tail) {
+            d->head = d->tail = 0;
+        }
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+/*
+ * Finds work for w: its own deque first, then its siblings'
+*/
+
+static int find(worker *w, task *t) {
+    pool *p = w->owner;
+
+    if(take(&w->queue, t, 1)) {
+        return 1;
+    }
+    for(int i = 1; i < p->size; i++) {
+        if(take(&p->workers[(w->id + i) % p->size].queue, t, 0)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Runs a task, then marks it finished in its future and in the pool
+*/
+
+static void execute(pool *p, task t) {
+    __atomic_sub_fetch(&p->queued, 1, __ATOMIC_ACQ_REL);
+    t.fn(t.arg);
+
+    if(t.future != NULL) {
+        pthread_mutex_lock(&t.future->lock);
+        if(--t.future->pending == 0) {
+            pthread_cond_broadcast(&t.future->done);
+        }
+        pthread_mutex_unlock(&t.future->lock);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    if(--p->pending == 0) {
+        pthread_cond_broadcast(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+/*
+ * Worker thread's loop
+*/
+
+static void *run(void *arg) {
+    worker *w = arg;
+    pool *p = w->owner;
+    self = w;
+
+    for(;;) {
+        task t;
+        if(find(w, &t)) {
+            execute(p, t);
+            continue;
+        }
+
+        // nothing to do: sleep until a task is queued or the pool stops
+        pthread_mutex_lock(&p->lock);
+        while(__atomic_load_n(&p->queued, __ATOMIC_ACQUIRE) == 0 && !p->stop) {
+            pthread_cond_wait(&p->work, &p->lock);
+        }
+        int stop = p->stop && __atomic_load_n(&p->queued, __ATOMIC_ACQUIRE) == 0;
+        pthread_mutex_unlock(&p->lock);
+        if(stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void share(void) {
+    shared = pool_create(0);
+}
+
+int pool_cores(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
+
+pool *pool_create(int threads) {
+    if(threads <= 0) {
+        threads = pool_cores();
+    }
+
+    pool *p = calloc(1, sizeof(pool));
+    if(p == NULL) {
+        return NULL;
+    }
+    p->workers = calloc(threads, sizeof(worker));
+    if(p->workers == NULL) {
+        free(p);
+        return NULL;
+    }
+    p->size = threads;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    for(int i = 0; i < threads; i++) {
+        p->workers[i].owner = p;
+        p->workers[i].id = i;
+        pthread_mutex_init(&p->workers[i].queue.lock, NULL);
+    }
+    for(int i = 0; i < threads; i++) {
+        pthread_create(&p->workers[i].thread, NULL, run, &p->workers[i]);
+    }
+    return p;
+}
+
+pool *pool_shared(void) {
+    pthread_once(&sharing, share);
+    return shared;
+}
+
+/*
+ * Queues a task, on the current worker's own deque if it's one of p's
+*/
+
+static void submit(pool *p, task t) {
+    // count the task first so that no worker goes to sleep while it's being queued
+    pthread_mutex_lock(&p->lock);
+    p->pending++;
+    __atomic_add_fetch(&p->queued, 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_unlock(&p->lock);
+
+    // workers keep their own subtasks; everything else is dealt round-robin
+    deque *d;
+    if(self != NULL && self->owner == p) {
+        d = &self->queue;
+    } else {
+        d = &p->workers[__atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED) % p->size].queue;
+    }
+
+    // with no room to queue it, the task runs right here instead
+    if(!push(d, t)) {
+        execute(p, t);
+        return;
+    }
+    pthread_cond_signal(&p->work);
+}
+
+void pool_submit(pool *p, task_fn fn, void *arg) {
+    submit(p, (task) { fn, arg, NULL });
+}
+
+void pool_async(pool *p, future *f, task_fn fn, void *arg) {
+    pthread_mutex_lock(&f->lock);
+    f->pending++;
+    pthread_mutex_unlock(&f->lock);
+
+    submit(p, (task) { fn, arg, f });
+}
+
+void future_init(future *f) {
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->done, NULL);
+    f->pending = 0;
+}
+
+int future_ready(future *f) {
+    pthread_mutex_lock(&f->lock);
+    int ready = (f->pending == 0);
+    pthread_mutex_unlock(&f->lock);
+    return ready;
+}
+
+void future_wait(future *f) {
+    // a worker waiting on its own pool runs tasks meanwhile (its future's
+    // among them), else the pool could end up with every worker waiting
+    while(self != NULL && !future_ready(f)) {
+        task t;
+        if(!find(self, &t)) {
+            break;
+        }
+        execute(self->owner, t);
+    }
+
+    pthread_mutex_lock(&f->lock);
+    while(f->pending > 0) {
+        pthread_cond_wait(&f->done, &f->lock);
+    }
+    pthread_mutex_unlock(&f->lock);
+}
+
+void future_destroy(future *f) {
+    pthread_mutex_destroy(&f->lock);
+    pthread_cond_destroy(&f->done);
+}
+
+void pool_wait(pool *p) {
+    pthread_mutex_lock(&p->lock);
+    while(p->pending > 0) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_destroy(pool *p) {
+    if(p == NULL) {
+        return;
+    }
+    pool_wait(p);
+
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+
+    for(int i = 0; i < p->size; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+    }
+    for(int i = 0; i < p->size; i++) {
+        pthread_mutex_destroy(&p->workers[i].queue.lock);
+        free(p->workers[i].queue.tasks);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work);
+    pthread_cond_destroy(&p->done);
+    free(p->workers);
+    free(p);
+}
+
+int pool_size(const pool *p) {
+    return p->size;
+}
@@ -0,0 +1,73 @@
+/****************************************************************************
+ * pool.h
+ *
+ * Work-stealing thread pool: every worker owns a deque of tasks, pops its
+ * own newest task first and steals the oldest one from a sibling when it
+ * runs dry.
+ *
+ * The process has one shared pool, with a worker per core, that every
+ * solving path submits to: threads are started once, not per board or
+ * per batch. A future tracks a set of tasks so that their submitter can
+ * wait for (or poll) just those, which the tasks' results (written
+ * through their args) are then safe to read after.
+ ***************************************************************************/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+// a unit of work
+typedef void (*task_fn)(void *arg);
+
+typedef struct pool pool;
+
+// tasks waited for together (plain data: callers own it, e.g. on the stack)
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+
+    // tasks not yet finished
+    int pending;
+} future;
+
+// starts a pool with this many workers (one per core if threads <= 0)
+pool *pool_create(int threads);
+
+// queues fn(arg); tasks may submit more tasks
+void pool_submit(pool *p, task_fn fn, void *arg);
+
+// the process's pool (one worker per core), started on first use and
+// never destroyed; NULL if it can't be started
+pool *pool_shared(void);
+
+// blocks until every submitted task has finished (on the shared pool,
+// that's everyone's: wait on a future instead)
+void pool_wait(pool *p);
+
+// queues fn(arg) as one of f's tasks
+void pool_async(pool *p, future *f, task_fn fn, void *arg);
+
+// starts f with no tasks
+void future_init(future *f);
+
+// returns 1 iff every one of f's tasks has finished
+int future_ready(future *f);
+
+// blocks until every one of f's tasks has finished; workers run queued
+// tasks meanwhile, so tasks can wait on tasks of their own
+void future_wait(future *f);
+
+// frees f's lock (once it's ready)
+void future_destroy(future *f);
+
+// waits for the pool's tasks, then stops and frees the pool
+void pool_destroy(pool *p);
+
+// number of workers
+int pool_size(const pool *p);
+
+// number of cores online
+int pool_cores(void);
+
+#endif
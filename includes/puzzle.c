@@ -3,63 +3,104 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include "puzzle.h"
 
+// counters of the solveBacktrack call running on this thread, if any
+static __thread solve_stats *counting;
+
+// a cell the backtracking engine fills, and the next digit to try there
+typedef struct {
+    short x, y;
+    short next;
+} frame;
+
 /*
- * Recursive algorithm that solves the board
+ * Backtracking algorithm that solves the board from cell (x, y) on, going
+ * down each column (x is the row) before the next one. It doesn't recurse:
+ * the empty cells are listed once, as the frames of a fixed-size stack,
+ * and the search walks up and down that stack. Returns 1 if solved, else 0
+ * with the board as it was (also once solveBacktrack's caller cancels it)
 */
 
-int solveSudoku(int x, int y, int board[9][9]) {
+int solveSudoku(int x, int y, int board[N][N]) {
 
-    int num = 1;
-    int tx = 0;
-    int ty = 0;
+    frame stack[CELLS];
+    int count = 0;
+    for(int k = y * N + x; k < CELLS; k++) {
+        if(board[k % N][k / N] == 0) {
+            stack[count++] = (frame) { k % N, k / N, 1 };
+        }
+    }
 
-    if(board[x][y] != 0) {
+    int depth = 0;
+    if(counting != NULL) {
+        counting->calls++;
+    }
+    STAT_DEPTH(counting, 1);
+    while(depth < count) {
+        frame *f = &stack[depth];
 
-        if(x == 8 && y == 8) {
-            return 1;
+        // the cell's own digit, if any, is being replaced
+        board[f->x][f->y] = 0;
+
+        int num = f->next;
+        while(num <= N) {
+            STAT_ADD(counting, tests, 1);
+            if(!sameSquare(f->x, f->y, num, board) && !sameRow(f->x, f->y, num, board) && !sameColumn(f->x, f->y, num, board)) {
+                break;
+            }
+            num++;
         }
 
-        if(x < 8) {
-            x++;
-        } else {
-            x = 0;
-            y++;
+        // out of digits: back to the previous cell, for its next digit
+        if(num > N) {
+            if(depth == 0) {
+                return 0;
+            }
+            STAT_ADD(counting, backtracks, 1);
+            depth--;
+            continue;
         }
 
-        if(solveSudoku(x, y, board)) {
-            return 1;
-        } else {
-            return 0;
+        board[f->x][f->y] = num;
+        f->next = num + 1;
+        if(counting != NULL) {
+            counting->guesses++;
         }
-    }
 
-    if(board[x][y] == 0) {
-        while(num < 10) {
-             if(!sameSquare(x, y, num, board) && !sameRow(x, y, num, board) && !sameColumn(x, y, num, board)) {            
-                board[x][y] = num;
-                if(x == 8 && y == 8) {
-                    return 1;
-                }
+        // on to the next empty cell, from its first digit
+        if(++depth < count) {
+            stack[depth].next = 1;
+            if(counting != NULL) {
+                counting->calls++;
+            }
+            STAT_DEPTH(counting, depth + 1);
 
-                if(x < 8) {
-                    tx++;
-                } else {
-                    tx = 0;
-                    ty = y + 1;
+            // called off: the cells filled so far are emptied again
+            if(CANCELLED(counting)) {
+                for(int k = 0; k < depth; k++) {
+                    board[stack[k].x][stack[k].y] = 0;
                 }
-
-                if(solveSudoku(tx, ty, board)) {
-                    return 1;
-                }                
-            }   
-            num++;         
+                return 0;
+            }
         }
-        board[x][y] = 0;
-        return 0;
     }
-    return 0;
+    return 1;
+}
+
+
+/*
+ * Solves the board from its first cell with the backtracking algorithm,
+ * counting into stats and giving up (returning 0) once *stats->cancel is set
+*/
+
+int solveBacktrack(int board[N][N], solve_stats *stats) {
+
+    counting = stats;
+    int solved = solveSudoku(0, 0, board);
+    counting = NULL;
+    return solved;
 }
 
 
@@ -67,9 +108,9 @@ int solveSudoku(int x, int y, int board[9][9]) {
  * Will return 1 (true) if the number we're passing already exists in the same column
 */
 
-int sameRow(int x, int y, int num, int board[9][9]) {
+int sameRow(int x, int y, int num, int board[N][N]) {
 
-    for(int i = 0; i < 9; i++) {
+    for(int i = 0; i < N; i++) {
         if(board[x][i] == num) {
             return 1;
         }
@@ -81,9 +122,9 @@ int sameRow(int x, int y, int num, int board[9][9]) {
  * Will return 1 (true) if the number we're passing already exists in the same row
 */
 
-int sameColumn(int x, int y, int num, int board[9][9]) {
+int sameColumn(int x, int y, int num, int board[N][N]) {
 
-    for(int i = 0; i < 9; i++) {
+    for(int i = 0; i < N; i++) {
         if(board[i][y] == num) {
             return 1;
         }
@@ -95,26 +136,14 @@ int sameColumn(int x, int y, int num, int board[9][9]) {
  * Will return 1 (true) if the number we're passing already exists in the same square
 */
 
-int sameSquare(int x, int y, int num, int board[9][9]) {
+int sameSquare(int x, int y, int num, int board[N][N]) {
 
-    if(x < 3) {
-        x = 0;
-    } else if(x < 6) {
-        x = 3;
-    } else {
-        x = 6;
-    }
-
-    if(y < 3) {
-        y = 0;
-    } else if(y < 6) {
-        y = 3;
-    } else {
-        y = 6;
-    }
+    // top-left cell of the box
+    x -= x % BOX;
+    y -= y % BOX;
 
-    for(int i = x; i < x + 3; i++) {
-        for(int j = y; j < y + 3; j++) {
+    for(int i = x; i < x + BOX; i++) {
+        for(int j = y; j < y + BOX; j++) {
             if(board[i][j] == num) {
                 return 1;
             }
@@ -123,3 +152,111 @@ int sameSquare(int x, int y, int num, int board[9][9]) {
     return 0;
 }
 
+
+/*
+ * Engines by number, their names, and how they count solutions (NULL if
+ * they can't)
+*/
+
+static const struct {
+    const char *name;
+    int (*solve)(int board[N][N], solve_stats *stats);
+    int (*count)(int board[N][N], int cap, solve_stats *stats);
+} engines[ENGINES] = {
+    [ENGINE_BACKTRACK] = { "backtrack", solveBacktrack, NULL },
+    [ENGINE_MASK] = { "mask", solveMask, countMask },
+    [ENGINE_DLX] = { "dlx", solveDlx, countDlx },
+    [ENGINE_PARALLEL] = { "parallel", solveParallel, countParallel },
+};
+
+/*
+ * Solves the board in place with the given engine (ENGINE_*)
+*/
+
+int solveWith(int engine, int board[N][N], solve_stats *stats) {
+
+    if(engine < 0 || engine >= ENGINES) {
+        return 0;
+    }
+    return engines[engine].solve(board, stats);
+}
+
+/*
+ * Counts the board's solutions, up to cap, with the given engine (ENGINE_*).
+ * Returns -1 if the engine can't count
+*/
+
+int countWith(int engine, int board[N][N], int cap, solve_stats *stats) {
+
+    if(!engineCounts(engine)) {
+        return -1;
+    }
+    return engines[engine].count(board, cap, stats);
+}
+
+/*
+ * Returns 1 iff the engine (ENGINE_*) can count solutions
+*/
+
+int engineCounts(int engine) {
+
+    return engine >= 0 && engine < ENGINES && engines[engine].count != NULL;
+}
+
+/*
+ * Returns the ENGINE_* called name, or -1 if there's none
+*/
+
+int engineByName(const char *name) {
+
+    for(int i = 0; i < ENGINES; i++) {
+        if(strcmp(name, engines[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *engineName(int engine) {
+
+    return (engine >= 0 && engine < ENGINES) ? engines[engine].name : "?";
+}
+
+/*
+ * Copies board into c. Returns 0 (leaving c partly written) if a cell isn't
+ * 0 to N
+*/
+
+int compactBoard(compact_board *c, int board[N][N]) {
+
+    for(int i = 0; i < CELLS; i++) {
+        int num = board[i / N][i % N];
+        if(num < 0 || num > N) {
+            return 0;
+        }
+        c->cell[i] = num;
+    }
+    return 1;
+}
+
+void expandBoard(const compact_board *c, int board[N][N]) {
+
+    for(int i = 0; i < CELLS; i++) {
+        board[i / N][i % N] = c->cell[i];
+    }
+}
+
+/*
+ * Solves the compact board in place with the given engine (ENGINE_*); the
+ * engine works on an int board of its own on the stack
+*/
+
+int solveCompact(int engine, compact_board *c, solve_stats *stats) {
+
+    int board[N][N];
+    expandBoard(c, board);
+    if(!solveWith(engine, board, stats)) {
+        return 0;
+    }
+    return compactBoard(c, board);
+}
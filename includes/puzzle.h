@@ -1,11 +1,167 @@
 /*
  * Header file for solving the puzzle - functions declaration
+ *
+ * Boards are N x N, as set by BOX in sudoku.h
 */
 
-int solveSudoku(int x, int y, int board[9][9]);
+#ifndef PUZZLE_H
+#define PUZZLE_H
 
-int sameRow(int x, int y, int num, int board[9][9]);
+#include <stddef.h>
+#include "sudoku.h"
 
-int sameColumn(int x, int y, int num, int board[9][9]);
+// counters an engine fills in while solving (engines take NULL to skip them)
+typedef struct {
+    // calls of the engine's recursive step
+    long calls;
 
-int sameSquare(int x, int y, int num, int board[9][9]);
\ No newline at end of file
+    // digits written on a guess, i.e. that may have to be undone later
+    long guesses;
+
+    // calls after which the mask engine gives up (0 for no limit)
+    long limit;
+
+    // the mask engine gives up as soon as this is set (NULL for never),
+    // e.g. by another thread that already found the answer, or as soon as
+    // outer is (the flag of a search this one is a part of)
+    const int *cancel;
+    const int *outer;
+
+    // STATS builds only (see sudoku.h): digits (or, for dlx, columns)
+    // checked for where they may go, guesses undone, and the deepest the
+    // engine's recursion went
+    long tests;
+    long backtracks;
+    int depth;
+} solve_stats;
+
+// whether whoever handed stats in has called the search off
+#define CANCELLED(stats) ((stats) != NULL && \
+    (((stats)->cancel != NULL && __atomic_load_n((stats)->cancel, __ATOMIC_RELAXED)) || \
+     ((stats)->outer != NULL && __atomic_load_n((stats)->outer, __ATOMIC_RELAXED))))
+
+// counting that STATS builds do on top of calls and guesses
+#if STATS
+#define STAT_ADD(stats, field, n) do { if((stats) != NULL) { (stats)->field += (n); } } while(0)
+#define STAT_DEPTH(stats, d) do { if((stats) != NULL && (d) > (stats)->depth) { (stats)->depth = (d); } } while(0)
+#else
+#define STAT_ADD(stats, field, n) ((void) 0)
+#define STAT_DEPTH(stats, d) ((void) 0)
+#endif
+
+int solveSudoku(int x, int y, int board[N][N]);
+
+int sameRow(int x, int y, int num, int board[N][N]);
+
+int sameColumn(int x, int y, int num, int board[N][N]);
+
+int sameSquare(int x, int y, int num, int board[N][N]);
+
+int solveBacktrack(int board[N][N], solve_stats *stats);
+
+// constraint-propagation engine (includes/mask.c)
+
+int solveMask(int board[N][N], solve_stats *stats);
+
+int countMask(int board[N][N], int cap, solve_stats *stats);
+
+int propagateMask(int board[N][N]);
+
+// parallel engine: the mask engine on branches of the search tree,
+// spread over all cores (includes/parallel.c)
+
+int solveParallel(int board[N][N], solve_stats *stats);
+
+int countParallel(int board[N][N], int cap, solve_stats *stats);
+
+// exact-cover engine with dancing links (includes/dlx.c)
+
+int solveDlx(int board[N][N], solve_stats *stats);
+
+int countDlx(int board[N][N], int cap, solve_stats *stats);
+
+// engines, selectable at runtime
+
+enum { ENGINE_BACKTRACK, ENGINE_MASK, ENGINE_DLX, ENGINE_PARALLEL, ENGINES };
+
+int solveWith(int engine, int board[N][N], solve_stats *stats);
+
+int countWith(int engine, int board[N][N], int cap, solve_stats *stats);
+
+int engineCounts(int engine);
+
+int engineByName(const char *name);
+
+const char *engineName(int engine);
+
+// compact boards (see sudoku.h) to and from the engines' int boards
+
+int compactBoard(compact_board *c, int board[N][N]);
+
+void expandBoard(const compact_board *c, int board[N][N]);
+
+int solveCompact(int engine, compact_board *c, solve_stats *stats);
+
+// batch kernels: candidates of LANES boards at once (includes/simd.c)
+
+#define LANES 16
+
+// LANES boards cell by cell: bits[i][b] is 1 << (digit in cell i of board b), 0 if empty
+typedef struct {
+    digit_mask bits[CELLS][LANES];
+} board_batch;
+
+void batchLoad(board_batch *batch, int b, int board[N][N]);
+
+void batchCandidates(const board_batch *batch, digit_mask cand[CELLS][LANES], unsigned *conflicts, unsigned *dead);
+
+const char *batchKernel(void);
+
+int batchUseKernel(const char *name);
+
+// puzzle generator (includes/generate.c)
+
+// what a generated board takes: singles alone, or a harder technique (or
+// guessing)
+enum { GRADE_SINGLES, GRADE_HARDER };
+
+void seedGenerator(unsigned long long *rng, unsigned long long seed);
+
+int generateBoard(int board[N][N], int grade, unsigned long long *rng);
+
+// logical engine: the techniques a person would use (includes/logic.c)
+
+// techniques, easiest first
+enum {
+    TECH_NAKED_SINGLE, TECH_HIDDEN_SINGLE, TECH_POINTING, TECH_CLAIMING, TECH_NAKED_PAIR,
+    TECH_HIDDEN_PAIR, TECH_NAKED_TRIPLE, TECH_HIDDEN_TRIPLE, TECH_X_WING, TECH_SWORDFISH, TECHNIQUES
+};
+
+// one deduction: a digit placed in a cell, or candidates eliminated
+typedef struct {
+    int technique;
+
+    // cell placed in (-1 if the step only eliminates), and the digit (0 if several)
+    int cell, digit;
+
+    // the unit the technique looked at (0 or N for fish on rows or columns),
+    // and the unit it cleared (pointing, claiming) or lines (bit k for line k, fish)
+    int unit;
+    unsigned cover;
+
+    // cells of unit (bit k for its k-th cell, or for line k with fish), and digits (bit d)
+    unsigned cells, digits;
+
+    // number of candidates eliminated
+    int eliminated;
+} logic_step;
+
+int gradeLogic(int board[N][N], int used[TECHNIQUES]);
+
+int hintLogic(int board[N][N], int skip, logic_step *hint);
+
+const char *techniqueName(int technique);
+
+void explainStep(const logic_step *step, char *text, size_t size);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Headless game sessions
+*/
+
+#include <string.h>
+#include "session.h"
+
+
+/*
+ * Writes value (0 to erase) into cell i, updating the counts in O(1)
+*/
+
+static void set(session *s, int i, int value) {
+    int y = i / N, x = i % N;
+    int old = s->board.cell[i];
+    int square = (y / BOX) * BOX + x / BOX;
+
+    if(old != 0) {
+        s->conflicts -= (--s->rows[y][old] > 0) + (--s->columns[x][old] > 0) + (--s->squares[square][old] > 0);
+        s->filled--;
+    }
+    if(old != 0 && old == s->solution.cell[i]) {
+        s->correct--;
+    }
+
+    s->board.cell[i] = value;
+    CELL_ADD(&s->dirty, i);
+
+    if(value != 0) {
+        s->conflicts += (s->rows[y][value]++ > 0) + (s->columns[x][value]++ > 0) + (s->squares[square][value]++ > 0);
+        s->filled++;
+    }
+    if(value != 0 && value == s->solution.cell[i]) {
+        s->correct++;
+    }
+}
+
+/*
+ * Recounts digits per row, column and square, and correct cells, of the whole board
+*/
+
+static void count(session *s) {
+    memset(s->rows, 0, sizeof(s->rows));
+    memset(s->columns, 0, sizeof(s->columns));
+    memset(s->squares, 0, sizeof(s->squares));
+    s->correct = 0;
+    s->filled = 0;
+    s->conflicts = 0;
+
+    for(int i = 0; i < CELLS; i++) {
+        int value = s->board.cell[i];
+        s->board.cell[i] = 0;
+        set(s, i, value);
+    }
+}
+
+void session_start(session *s, int number, const compact_board *board) {
+    s->number = number;
+    s->board = *board;
+    memset(&s->solution, 0, sizeof(s->solution));
+
+    // the level's own numbers can't be changed
+    memset(&s->givens, 0, sizeof(s->givens));
+    for(int i = 0; i < CELLS; i++) {
+        if(board->cell[i] != 0) {
+            CELL_ADD(&s->givens, i);
+        }
+    }
+
+    // from now on kept up to date by set (which marks every cell dirty)
+    count(s);
+
+    s->y = s->x = N / 2;
+}
+
+void session_solve(session *s, const compact_board *solution) {
+    s->solution = *solution;
+
+    // correct cells can only be counted now
+    count(s);
+}
+
+int session_move(session *s, int y, int x, int value) {
+    if(y < 0 || y >= N || x < 0 || x >= N || value < 0 || value > N) {
+        return MOVE_INVALID;
+    }
+    int i = y * N + x;
+    if(CELL_HAS(&s->givens, i)) {
+        return MOVE_GIVEN;
+    }
+
+    // take the cell's old number out of the counts before checking the new one
+    set(s, i, 0);
+    int conflict = value != 0 && session_conflict(s, y, x, value);
+    set(s, i, value);
+    return conflict ? MOVE_CONFLICT : MOVE_OK;
+}
+
+int session_conflict(const session *s, int y, int x, int value) {
+    int own = (s->board.cell[y * N + x] == value);
+    return s->rows[y][value] > own || s->columns[x][value] > own ||
+           s->squares[(y / BOX) * BOX + x / BOX][value] > own;
+}
+
+int session_won(const session *s) {
+    return s->correct == CELLS || (s->filled == CELLS && s->conflicts == 0);
+}
+
+void session_cursor(session *s, int dy, int dx) {
+    s->y = ((s->y + dy) % N + N) % N;
+    s->x = ((s->x + dx) % N + N) % N;
+}
+
+int session_key(session *s, int ch) {
+    switch(ch) {
+        case SESSION_UP:
+            session_cursor(s, -1, 0);
+            return -1;
+        case SESSION_DOWN:
+            session_cursor(s, 1, 0);
+            return -1;
+        case SESSION_LEFT:
+            session_cursor(s, 0, -1);
+            return -1;
+        case SESSION_RIGHT:
+            session_cursor(s, 0, 1);
+            return -1;
+    }
+
+    int value = session_symbol(ch);
+    return (value >= 0) ? session_move(s, s->y, s->x, value) : -1;
+}
+
+int session_symbol(int ch) {
+    if(ch == '0') {
+        return 0;
+    }
+    for(int i = 0; i < N; i++) {
+        if(ch == SYMBOLS[i]) {
+            return i + 1;
+        }
+    }
+    return -1;
+}
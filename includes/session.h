@@ -0,0 +1,83 @@
+/****************************************************************************
+ * session.h
+ *
+ * A game of Sudoku without a screen: the board being played, its givens,
+ * its solution once known, and counts of digits per row, column and square
+ * kept up to date move by move, so conflicts and wins are O(1) queries.
+ *
+ * A session is plain data with no globals behind it, so any number of them
+ * can be played at once (one per connection, say), each by one thread at a
+ * time. The ncurses game in sudoku.c is one front end.
+ ***************************************************************************/
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "sudoku.h"
+
+// what session_move did
+enum {
+    MOVE_OK,          // the cell was set (or erased)
+    MOVE_CONFLICT,    // the cell was set, but its digit repeats in its row, column or square
+    MOVE_GIVEN,       // nothing: the cell is one of the board's givens
+    MOVE_INVALID      // nothing: no such cell or digit
+};
+
+// keycodes of the arrow keys, as ncurses reports them (KEY_UP and so on)
+#define SESSION_DOWN 0402
+#define SESSION_UP 0403
+#define SESSION_LEFT 0404
+#define SESSION_RIGHT 0405
+
+typedef struct {
+    // the board's number, and which of its cells are givens
+    int number;
+    cell_set givens;
+
+    // the board as played, and its solution (all zeros until it's known)
+    compact_board board, solution;
+
+    // how many times each digit appears in each row, column and square of board
+    unsigned char rows[N][N + 1], columns[N][N + 1], squares[N][N + 1];
+
+    // number of board's cells that match solution, that aren't empty, and
+    // of extra copies of digits within rows, columns and squares
+    int correct, filled, conflicts;
+
+    // the cursor's current location between (0,0) and (N-1,N-1)
+    int y, x;
+
+    // cells changed since the front end last cleared this
+    cell_set dirty;
+} session;
+
+// starts a game of board (its number is only kept for the front end), with
+// the cursor at the center and no solution known yet
+void session_start(session *s, int number, const compact_board *board);
+
+// hands the session the board's (complete) solution, so correct cells count
+void session_solve(session *s, const compact_board *solution);
+
+// writes value (0 to erase) into cell (y, x); returns MOVE_*
+int session_move(session *s, int y, int x, int value);
+
+// returns 1 iff value already appears in the row, column or square of cell
+// (y, x), not counting the cell itself
+int session_conflict(const session *s, int y, int x, int value);
+
+// returns 1 iff the board is solved: it matches the solution, or it's full
+// without conflicts (even if the level has another solution)
+int session_won(const session *s);
+
+// moves the cursor by dy rows and dx columns, wrapping around the edges
+void session_cursor(session *s, int dy, int dx);
+
+// plays a keypress (letters in upper case): arrows move the cursor and
+// SYMBOLS or '0' write into the cursor's cell, returning MOVE_*; other keys
+// do nothing and return -1
+int session_key(session *s, int ch);
+
+// the digit (1 to N) shown as ch, 0 for '0' (erase), or -1 if ch isn't one of them
+int session_symbol(int ch);
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * Batch kernels: candidates of LANES boards at once.
+ *
+ * Boards are stored cell by cell (struct of arrays), each cell as the bit
+ * of its digit, so a row's digits are the OR of N vectors, a repeated
+ * digit shows up in the AND of a cell with the row so far, and candidates
+ * are the digits left after the cell's row, column and square. The
+ * same steps run on AVX2 (16 boards per register, 8 for boards of 16 digits
+ * or more, whose masks take 32 bits), SSE2 (half as many) or plain C,
+ * whichever the CPU supports, picked at runtime.
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "puzzle.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define X86 1
+#endif
+
+// bits 1 to N set, one per digit
+#define ALL ((digit_mask) ((1u << (N + 1)) - 2))
+
+// units (rows, columns and squares) of cell i
+#define ROW(i) ((i) / N)
+#define COLUMN(i) (N + (i) % N)
+#define SQUARE(i) (2 * N + ((i) / (N * BOX)) * BOX + ((i) % N) / BOX)
+
+// a kernel fills in unit masks, candidates and per-lane flags
+typedef void (*kernel)(const board_batch *batch, digit_mask cand[CELLS][LANES],
+                       digit_mask conflict[LANES], digit_mask dead[LANES]);
+
+
+/*
+ * Returns the k-th cell (0 to N - 1) of unit u: rows are 0 to N - 1, columns
+ * N to 2N - 1, squares 2N to 3N - 1
+*/
+
+static inline int unitCell(int u, int k) {
+    if(u < N) {
+        return u * N + k;
+    } else if(u < 2 * N) {
+        return k * N + (u - N);
+    } else {
+        u -= 2 * N;
+        return ((u / BOX) * BOX + k / BOX) * N + (u % BOX) * BOX + k % BOX;
+    }
+}
+
+static void kernelScalar(const board_batch *batch, digit_mask cand[CELLS][LANES],
+                         digit_mask conflict[LANES], digit_mask dead[LANES]) {
+
+    digit_mask unit[3 * N][LANES];
+
+    for(int b = 0; b < LANES; b++) {
+        conflict[b] = 0;
+        dead[b] = 0;
+    }
+    for(int u = 0; u < 3 * N; u++) {
+        for(int b = 0; b < LANES; b++) {
+            digit_mask seen = 0, twice = 0;
+            for(int k = 0; k < N; k++) {
+                digit_mask bit = batch->bits[unitCell(u, k)][b];
+                twice |= seen & bit;
+                seen |= bit;
+            }
+            unit[u][b] = seen;
+            conflict[b] |= twice;
+        }
+    }
+    for(int i = 0; i < CELLS; i++) {
+        int r = ROW(i), c = COLUMN(i), s = SQUARE(i);
+        for(int b = 0; b < LANES; b++) {
+            digit_mask empty = (batch->bits[i][b] == 0) ? (digit_mask) ~0u : 0;
+            cand[i][b] = ~(unit[r][b] | unit[c][b] | unit[s][b]) & ALL & empty;
+            dead[b] |= (cand[i][b] == 0) & empty;
+        }
+    }
+}
+
+#ifdef X86
+
+// lanes per register, and the intrinsics for lanes as wide as digit_mask
+#define PER128 (16 / (int) sizeof(digit_mask))
+#define PER256 (32 / (int) sizeof(digit_mask))
+#if N < 16
+#define SET128 _mm_set1_epi16
+#define CMPEQ128 _mm_cmpeq_epi16
+#define SET256 _mm256_set1_epi16
+#define CMPEQ256 _mm256_cmpeq_epi16
+#else
+#define SET128 _mm_set1_epi32
+#define CMPEQ128 _mm_cmpeq_epi32
+#define SET256 _mm256_set1_epi32
+#define CMPEQ256 _mm256_cmpeq_epi32
+#endif
+
+__attribute__((target("sse2")))
+static void kernelSse2(const board_batch *batch, digit_mask cand[CELLS][LANES],
+                       digit_mask conflict[LANES], digit_mask dead[LANES]) {
+
+    enum { REGS = LANES / PER128 };
+    __m128i unit[3 * N][REGS];
+    __m128i twice[REGS], none[REGS];
+    const __m128i all = SET128(ALL), zero = _mm_setzero_si128();
+
+    for(int v = 0; v < REGS; v++) {
+        twice[v] = zero;
+        none[v] = zero;
+    }
+    for(int u = 0; u < 3 * N; u++) {
+        for(int v = 0; v < REGS; v++) {
+            __m128i seen = zero;
+            for(int k = 0; k < N; k++) {
+                __m128i bit = _mm_loadu_si128((const __m128i *) &batch->bits[unitCell(u, k)][v * PER128]);
+                twice[v] = _mm_or_si128(twice[v], _mm_and_si128(seen, bit));
+                seen = _mm_or_si128(seen, bit);
+            }
+            unit[u][v] = seen;
+        }
+    }
+    for(int i = 0; i < CELLS; i++) {
+        int r = ROW(i), c = COLUMN(i), s = SQUARE(i);
+        for(int v = 0; v < REGS; v++) {
+            __m128i bits = _mm_loadu_si128((const __m128i *) &batch->bits[i][v * PER128]);
+            __m128i empty = CMPEQ128(bits, zero);
+            __m128i used = _mm_or_si128(unit[r][v], _mm_or_si128(unit[c][v], unit[s][v]));
+            __m128i free = _mm_and_si128(_mm_andnot_si128(used, all), empty);
+            _mm_storeu_si128((__m128i *) &cand[i][v * PER128], free);
+            none[v] = _mm_or_si128(none[v], _mm_and_si128(CMPEQ128(free, zero), empty));
+        }
+    }
+    for(int v = 0; v < REGS; v++) {
+        _mm_storeu_si128((__m128i *) &conflict[v * PER128], twice[v]);
+        _mm_storeu_si128((__m128i *) &dead[v * PER128], none[v]);
+    }
+}
+
+__attribute__((target("avx2")))
+static void kernelAvx2(const board_batch *batch, digit_mask cand[CELLS][LANES],
+                       digit_mask conflict[LANES], digit_mask dead[LANES]) {
+
+    enum { REGS = LANES / PER256 };
+    __m256i unit[3 * N][REGS];
+    __m256i twice[REGS], none[REGS];
+    const __m256i all = SET256(ALL), zero = _mm256_setzero_si256();
+
+    for(int v = 0; v < REGS; v++) {
+        twice[v] = zero;
+        none[v] = zero;
+    }
+    for(int u = 0; u < 3 * N; u++) {
+        for(int v = 0; v < REGS; v++) {
+            __m256i seen = zero;
+            for(int k = 0; k < N; k++) {
+                __m256i bit = _mm256_loadu_si256((const __m256i *) &batch->bits[unitCell(u, k)][v * PER256]);
+                twice[v] = _mm256_or_si256(twice[v], _mm256_and_si256(seen, bit));
+                seen = _mm256_or_si256(seen, bit);
+            }
+            unit[u][v] = seen;
+        }
+    }
+    for(int i = 0; i < CELLS; i++) {
+        int r = ROW(i), c = COLUMN(i), s = SQUARE(i);
+        for(int v = 0; v < REGS; v++) {
+            __m256i bits = _mm256_loadu_si256((const __m256i *) &batch->bits[i][v * PER256]);
+            __m256i empty = CMPEQ256(bits, zero);
+            __m256i used = _mm256_or_si256(unit[r][v], _mm256_or_si256(unit[c][v], unit[s][v]));
+            __m256i free = _mm256_and_si256(_mm256_andnot_si256(used, all), empty);
+            _mm256_storeu_si256((__m256i *) &cand[i][v * PER256], free);
+            none[v] = _mm256_or_si256(none[v], _mm256_and_si256(CMPEQ256(free, zero), empty));
+        }
+    }
+    for(int v = 0; v < REGS; v++) {
+        _mm256_storeu_si256((__m256i *) &conflict[v * PER256], twice[v]);
+        _mm256_storeu_si256((__m256i *) &dead[v * PER256], none[v]);
+    }
+}
+
+#endif
+
+// kernels by name, best first
+static const struct {
+    const char *name;
+    kernel run;
+} kernels[] = {
+#ifdef X86
+    { "avx2", kernelAvx2 },
+    { "sse2", kernelSse2 },
+#endif
+    { "scalar", kernelScalar },
+};
+
+#define KERNELS (int) (sizeof(kernels) / sizeof(kernels[0]))
+
+// the kernel in use, -1 until one is picked
+static int chosen = -1;
+
+
+/*
+ * Returns 1 iff the CPU can run kernel k
+*/
+
+static int supported(int k) {
+#ifdef X86
+    __builtin_cpu_init();
+    if(strcmp(kernels[k].name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if(strcmp(kernels[k].name, "sse2") == 0) {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+    return 1;
+}
+
+/*
+ * Picks the best kernel the CPU supports, unless one was chosen already
+*/
+
+static int pick(void) {
+    int k = __atomic_load_n(&chosen, __ATOMIC_ACQUIRE);
+    if(k < 0) {
+        for(k = 0; !supported(k); k++) {
+        }
+        __atomic_store_n(&chosen, k, __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+/*
+ * Writes the board into lane b of the batch
+*/
+
+void batchLoad(board_batch *batch, int b, int board[N][N]) {
+
+    for(int i = 0; i < CELLS; i++) {
+        int num = board[i / N][i % N];
+        batch->bits[i][b] = (num >= 1 && num <= N) ? 1u << num : 0;
+    }
+}
+
+/*
+ * Computes every empty cell's candidates (0 for filled cells) for all lanes
+ * at once. Bit b of *conflicts is set if board b's digits already repeat in
+ * a row, column or square, and bit b of *dead if one of its empty cells has
+ * no candidate left
+*/
+
+void batchCandidates(const board_batch *batch, digit_mask cand[CELLS][LANES], unsigned *conflicts, unsigned *dead) {
+
+    digit_mask conflict[LANES], none[LANES];
+    kernels[pick()].run(batch, cand, conflict, none);
+
+    *conflicts = 0;
+    *dead = 0;
+    for(int b = 0; b < LANES; b++) {
+        *conflicts |= (unsigned) (conflict[b] != 0) << b;
+        *dead |= (unsigned) (none[b] != 0) << b;
+    }
+}
+
+/*
+ * Returns the name of the kernel in use
+*/
+
+const char *batchKernel(void) {
+
+    return kernels[pick()].name;
+}
+
+/*
+ * Forces a kernel by name. Returns 0 if there's no such kernel or the CPU
+ * can't run it
+*/
+
+int batchUseKernel(const char *name) {
+
+    for(int k = 0; k < KERNELS; k++) {
+        if(strcmp(name, kernels[k].name) == 0 && supported(k)) {
+            __atomic_store_n(&chosen, k, __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+    return 0;
+}
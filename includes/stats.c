@@ -0,0 +1,74 @@
+/*
+ * Solver counters and phase timings of boards played
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "stats.h"
+
+static const char *phases[PHASES] = {
+    [PHASE_LOAD] = "load_ms",
+    [PHASE_SOLVE] = "solve_ms",
+    [PHASE_COPY] = "copy_ms",
+    [PHASE_DRAW] = "draw_ms",
+};
+
+static const char *sources[] = {
+    [FROM_NOWHERE] = "none",
+    [FROM_CACHE] = "cache",
+    [FROM_SOLVER] = "solver",
+    [FROM_CANCELLED] = "cancelled",
+};
+
+
+double stats_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+board_stats *stats_add(stats_log *log, int number) {
+    if(log->count == log->room) {
+        int room = (log->room == 0) ? 64 : 2 * log->room;
+        board_stats *boards = realloc(log->boards, room * sizeof(board_stats));
+        if(boards == NULL) {
+            return NULL;
+        }
+        log->boards = boards;
+        log->room = room;
+    }
+
+    board_stats *b = &log->boards[log->count++];
+    *b = (board_stats) { .number = number };
+    return b;
+}
+
+int stats_dump(const stats_log *log, const char *path, const char *level, const char *engine) {
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL) {
+        return 0;
+    }
+
+    fprintf(fp, "{\n  \"level\": \"%s\",\n  \"engine\": \"%s\",\n  \"box\": %d,\n  \"boards\": [",
+            level, engine, BOX);
+    for(int i = 0; i < log->count; i++) {
+        const board_stats *b = &log->boards[i];
+        fprintf(fp, "%s\n    { \"number\": %d, \"solved\": \"%s\"", (i == 0) ? "" : ",", b->number, sources[b->from]);
+        for(int p = 0; p < PHASES; p++) {
+            fprintf(fp, ", \"%s\": %.3f", phases[p], b->phase[p]);
+        }
+        fprintf(fp, ", \"solver_ms\": %.3f, \"calls\": %ld, \"guesses\": %ld, \"tests\": %ld, \"backtracks\": %ld, \"depth\": %d }",
+                b->solver_ms, b->solver.calls, b->solver.guesses, b->solver.tests, b->solver.backtracks, b->solver.depth);
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    return fclose(fp) == 0;
+}
+
+void stats_free(stats_log *log) {
+    free(log->boards);
+    log->boards = NULL;
+    log->count = log->room = 0;
+}
@@ -0,0 +1,56 @@
+/****************************************************************************
+ * stats.h
+ *
+ * What STATS builds (see sudoku.h) measure of every board played: the
+ * solver's counters and how long each phase of starting the board took,
+ * kept in memory and dumped as JSON when the game ends, e.g.
+ *
+ *   { "level": "l33t", "engine": "mask", "box": 3, "boards": [
+ *     { "number": 907, "solved": "solver", "load_ms": 0.004, ...,
+ *       "calls": 12, "tests": 301, "backtracks": 3, "depth": 4, ... } ] }
+ ***************************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "puzzle.h"
+
+// phases of starting a board
+enum { PHASE_LOAD, PHASE_SOLVE, PHASE_COPY, PHASE_DRAW, PHASES };
+
+// where a board's solution came from
+enum { FROM_NOWHERE, FROM_CACHE, FROM_SOLVER, FROM_CANCELLED };
+
+typedef struct {
+    int number;
+
+    // FROM_*: nowhere yet (or the board has no solution), the cache, or the
+    // solver task, in which case solver and solver_ms are filled in (as they
+    // are when the board was left before its solver task was done)
+    int from;
+    solve_stats solver;
+    double solver_ms;
+
+    // how long each phase (PHASE_*) took, in ms
+    double phase[PHASES];
+} board_stats;
+
+typedef struct {
+    // every board played, in order
+    board_stats *boards;
+    int count, room;
+} stats_log;
+
+// the time, in ms, on a clock that only goes forward
+double stats_ms(void);
+
+// adds a board to the log and returns its (zeroed) record, or NULL if out of memory
+board_stats *stats_add(stats_log *log, int number);
+
+// writes the log as JSON to path; returns 0 on failure
+int stats_dump(const stats_log *log, const char *path, const char *level, const char *engine);
+
+// frees the log's boards
+void stats_free(stats_log *log);
+
+#endif
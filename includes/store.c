@@ -0,0 +1,343 @@
+/*
+ * Memory-mapped board store
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "puzzle.h"
+#include "store.h"
+
+
+/*
+ * Reads a little-endian 16 or 32-bit field of a header
+*/
+
+static unsigned read16(const unsigned char *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t read32(const unsigned char *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static void write32(unsigned char *p, uint32_t v) {
+    for(int i = 0; i < 4; i++) {
+        p[i] = v >> (8 * i);
+    }
+}
+
+/*
+ * Reads and writes cell i of a packed board, PACK_BITS bits from bit
+ * i * PACK_BITS on (a cell may straddle two bytes)
+*/
+
+static int unpack(const unsigned char *p, int i) {
+    size_t bit = (size_t) i * PACK_BITS;
+    unsigned window = p[bit / 8];
+    if(bit % 8 + PACK_BITS > 8) {
+        window |= p[bit / 8 + 1] << 8;
+    }
+    return (window >> (bit % 8)) & ((1u << PACK_BITS) - 1);
+}
+
+static void pack(unsigned char *p, int i, int num) {
+    size_t bit = (size_t) i * PACK_BITS;
+    p[bit / 8] |= num << (bit % 8);
+    if(bit % 8 + PACK_BITS > 8) {
+        p[bit / 8 + 1] |= num >> (8 - bit % 8);
+    }
+}
+
+/*
+ * Returns 1 iff the bucket table of an indexed file is sorted and ends at count
+*/
+
+static int valid_index(const unsigned char *index, uint32_t count) {
+    uint32_t prev = 0;
+    for(int d = 0; d <= PACK_BUCKETS; d++) {
+        uint32_t first = read32(index + 4 * d);
+        if(first < prev || first > count) {
+            return 0;
+        }
+        prev = first;
+    }
+    return prev == count;
+}
+
+/*
+ * Fills in format, level, count and boards from the mapped file's size and
+ * header. Returns 0 if neither format fits
+*/
+
+static int parse(store *s) {
+    if(s->size >= PACK_HEADER && memcmp(s->data, PACK_MAGIC, 4) == 0) {
+        uint32_t count = read32(s->data + 8);
+        unsigned version = read16(s->data + 4);
+        size_t start = PACK_HEADER, stride = PACK_BOARD;
+        if(version == 2 || version == 3) {
+            start += PACK_INDEX + ((version == 3) ? (size_t) count * 4 : 0);
+            stride = PACK_RECORD;
+        } else if(version != 1) {
+            return 0;
+        }
+        // files from before the box size was recorded hold 9x9 boards
+        int box = (s->data[7] != 0) ? s->data[7] : 3;
+        if(box != BOX || count == 0 || count > INT32_MAX || s->size != start + (size_t) count * stride ||
+           (version >= 2 && !valid_index(s->data + PACK_HEADER, count))) {
+            return 0;
+        }
+        s->format = STORE_PACKED;
+        s->level = s->data[6];
+        s->count = count;
+        s->boards = s->data + start;
+        s->stride = stride;
+        s->index = (version >= 2) ? s->data + PACK_HEADER : NULL;
+        s->order = (version == 3) ? s->data + PACK_HEADER + PACK_INDEX : NULL;
+        return 1;
+    }
+
+    // ensure file is of expected size
+    if(s->size == 0 || s->size % (CELLS * INTSIZE) != 0) {
+        return 0;
+    }
+    s->format = STORE_RAW;
+    s->level = LEVEL_UNKNOWN;
+    s->count = s->size / (CELLS * INTSIZE);
+    s->boards = s->data;
+    s->stride = CELLS * INTSIZE;
+    s->index = NULL;
+    s->order = NULL;
+    return 1;
+}
+
+int store_open(store *s, const char *path) {
+    memset(s, 0, sizeof(store));
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    // the mapping outlives the descriptor
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return 0;
+    }
+    s->data = data;
+    s->size = st.st_size;
+
+    if(!parse(s)) {
+        store_close(s);
+        return 0;
+    }
+    return 1;
+}
+
+void store_close(store *s) {
+    if(s->data != NULL) {
+        munmap((void *) s->data, s->size);
+    }
+    memset(s, 0, sizeof(store));
+}
+
+const int32_t *store_board(const store *s, int n) {
+    if(s->data == NULL || s->format != STORE_RAW || n < 1 || n > s->count) {
+        return NULL;
+    }
+    return (const int32_t *) (s->boards + (size_t) (n - 1) * s->stride);
+}
+
+int store_read(const store *s, int n, int board[N][N]) {
+    if(s->data == NULL || n < 1 || n > s->count) {
+        return 0;
+    }
+
+    if(s->format == STORE_RAW) {
+        memcpy(board, store_board(s, n), CELLS * INTSIZE);
+        return 1;
+    }
+
+    const unsigned char *p = s->boards + (size_t) (n - 1) * s->stride;
+    for(int i = 0; i < CELLS; i++) {
+        int num = unpack(p, i);
+        if(num > N) {
+            return 0;
+        }
+        board[i / N][i % N] = num;
+    }
+    return 1;
+}
+
+int store_difficulty(const store *s, int n) {
+    if(s->data == NULL || s->index == NULL || n < 1 || n > s->count) {
+        return -1;
+    }
+    return s->boards[(size_t) (n - 1) * s->stride + PACK_BOARD];
+}
+
+int store_tags(const store *s, int n) {
+    if(s->data == NULL || s->index == NULL || n < 1 || n > s->count) {
+        return -1;
+    }
+    return s->boards[(size_t) (n - 1) * s->stride + PACK_BOARD + 1];
+}
+
+int store_pick(const store *s, int lo, int hi, unsigned r) {
+    if(s->data == NULL) {
+        return 0;
+    }
+    if(s->index == NULL) {
+        return r % s->count + 1;
+    }
+
+    lo = (lo < 0) ? 0 : lo;
+    hi = (hi >= PACK_BUCKETS) ? PACK_BUCKETS - 1 : hi;
+    if(lo > hi) {
+        return 0;
+    }
+
+    // boards [first, end) of the order are the ones in range
+    uint32_t first = read32(s->index + 4 * lo);
+    uint32_t end = read32(s->index + 4 * (hi + 1));
+    if(first >= end) {
+        return 0;
+    }
+    uint32_t k = first + r % (end - first);
+    if(s->order == NULL) {
+        return k + 1;
+    }
+    uint32_t n = read32(s->order + 4 * k);
+    return (n >= 1 && n <= (uint32_t) s->count) ? (int) n : 0;
+}
+
+/*
+ * Grades a board for the index: 20 per step up the logical techniques it
+ * needs (TECH_*, or TECHNIQUES if logic gets stuck), plus its number of
+ * empty cells over 4 and, once logic is stuck, 4 per guess the mask engine
+ * makes (boards without a solution are the hardest there is)
+*/
+
+static void grade(int board[N][N], unsigned char *difficulty, unsigned char *tags) {
+    int copy[N][N];
+    int empty = 0, symmetric = 1;
+    for(int i = 0; i < CELLS; i++) {
+        copy[i / N][i % N] = board[i / N][i % N];
+        empty += (board[i / N][i % N] == 0);
+        symmetric = symmetric && ((board[i / N][i % N] == 0) == (board[N - 1 - i / N][N - 1 - i % N] == 0));
+    }
+
+    // logic solves what it can of copy, and the mask engine the rest
+    int hardest = gradeLogic(copy, NULL);
+    solve_stats stats = { 0 };
+    if(hardest == TECHNIQUES && !solveMask(copy, &stats)) {
+        *difficulty = PACK_BUCKETS - 1;
+        *tags = 0;
+        return;
+    }
+    long score = 20 * hardest + empty / 4 + 4 * stats.guesses;
+    *difficulty = (score < PACK_BUCKETS) ? score : PACK_BUCKETS - 1;
+    *tags = (hardest <= TECH_HIDDEN_SINGLE ? TAG_SINGLES : 0) | (hardest < TECHNIQUES ? TAG_LOGIC : 0) |
+            (symmetric ? TAG_SYMMETRIC : 0);
+}
+
+int store_pack(const store *s, const char *path, int level) {
+
+    // grade every board, then order them by difficulty (counting sort); the
+    // boards themselves stay in the order they're numbered in
+    unsigned char (*grades)[2] = malloc((size_t) s->count * 2);
+    unsigned char *order = malloc((size_t) s->count * 4);
+    uint32_t first[PACK_BUCKETS + 1] = { 0 };
+    int ok = grades != NULL && order != NULL;
+    for(int n = 1; ok && n <= s->count; n++) {
+        int board[N][N];
+        ok = store_read(s, n, board);
+        if(ok) {
+            grade(board, &grades[n - 1][0], &grades[n - 1][1]);
+            first[grades[n - 1][0] + 1]++;
+        }
+    }
+    for(int d = 1; d <= PACK_BUCKETS; d++) {
+        first[d] += first[d - 1];
+    }
+
+    unsigned char index[PACK_INDEX];
+    for(int d = 0; d <= PACK_BUCKETS; d++) {
+        write32(index + 4 * d, first[d]);
+    }
+    for(int n = 1; ok && n <= s->count; n++) {
+        write32(order + 4 * first[grades[n - 1][0]]++, n);
+    }
+
+    // written next to path and renamed over it once complete, so a failed
+    // pack never leaves path truncated or gone
+    char tmp[strlen(path) + 5];
+    sprintf(tmp, "%s.tmp", path);
+    FILE *fp = ok ? fopen(tmp, "wb") : NULL;
+    if(fp == NULL) {
+        free(grades);
+        free(order);
+        return 0;
+    }
+
+    unsigned char header[PACK_HEADER] = { 0 };
+    memcpy(header, PACK_MAGIC, 4);
+    header[4] = PACK_VERSION & 0xFF;
+    header[5] = PACK_VERSION >> 8;
+    header[6] = level;
+    header[7] = BOX;
+    write32(header + 8, s->count);
+    ok = fwrite(header, PACK_HEADER, 1, fp) == 1 && fwrite(index, PACK_INDEX, 1, fp) == 1 &&
+         fwrite(order, 4, s->count, fp) == (size_t) s->count;
+
+    for(int n = 1; ok && n <= s->count; n++) {
+        int board[N][N];
+        unsigned char packed[PACK_RECORD] = { 0 };
+
+        ok = store_read(s, n, board);
+        for(int i = 0; ok && i < CELLS; i++) {
+            int num = board[i / N][i % N];
+            if(num < 0 || num > N) {
+                ok = 0;
+            } else {
+                pack(packed, i, num);
+            }
+        }
+        packed[PACK_BOARD] = grades[n - 1][0];
+        packed[PACK_BOARD + 1] = grades[n - 1][1];
+        ok = ok && fwrite(packed, PACK_RECORD, 1, fp) == 1;
+    }
+
+    ok = (fclose(fp) == 0) && ok;
+    ok = ok && rename(tmp, path) == 0;
+    if(!ok) {
+        remove(tmp);
+    }
+    free(grades);
+    free(order);
+    return ok;
+}
+
+int store_level(const char *name) {
+    if(strcmp(name, "debug") == 0) {
+        return LEVEL_DEBUG;
+    } else if(strcmp(name, "n00b") == 0) {
+        return LEVEL_N00B;
+    } else if(strcmp(name, "l33t") == 0) {
+        return LEVEL_L33T;
+    }
+    return LEVEL_UNKNOWN;
+}
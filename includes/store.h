@@ -0,0 +1,114 @@
+/****************************************************************************
+ * store.h
+ *
+ * Read-only store of boards, backed by a memory-mapped board file.
+ *
+ * Two on-disk formats are understood:
+ *
+ *   raw     CELLS little-endian INTSIZE-byte ints per board, no header
+ *           (the original n00b.bin/l33t.bin layout)
+ *
+ *   packed  a PACK_HEADER-byte header (magic "SDKP", version, level,
+ *           box size, board count) followed by PACK_BOARD bytes per
+ *           board, PACK_BITS bits per cell, lowest bits first: two cells
+ *           per byte (low nibble first) for boards of up to 15 digits,
+ *           5 bits per cell for 16x16 and 25x25 boards
+ *
+ * Packed files of version 3 are indexed: the header is followed by
+ * PACK_BUCKETS + 1 little-endian 32-bit ints, where entry d is the position
+ * of the first board of difficulty d in the order below (and the last entry
+ * is the count), then the order: the number of every board (counting from
+ * 1, 32-bit little-endian), sorted by difficulty. Then come PACK_RECORD
+ * bytes per board: its packed cells, its difficulty and its tags. Boards
+ * keep their source file's order, and so their numbers, while a random
+ * board in a range of difficulties is three lookups away. Version 2 files
+ * (boards themselves sorted by difficulty, no order) and version 1 files
+ * (no index) are still read.
+ ***************************************************************************/
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sudoku.h"
+
+// packed format's magic, version and sizes (in bytes)
+#define PACK_MAGIC "SDKP"
+#define PACK_VERSION 3
+#define PACK_HEADER 16
+#define PACK_BITS ((N <= 15) ? 4 : 5)
+#define PACK_BOARD ((CELLS * PACK_BITS + 7) / 8)
+
+// difficulties (0 to PACK_BUCKETS - 1), index size and board size of indexed files
+#define PACK_BUCKETS 256
+#define PACK_INDEX ((PACK_BUCKETS + 1) * 4)
+#define PACK_RECORD (PACK_BOARD + 2)
+
+enum { STORE_RAW, STORE_PACKED };
+
+// levels recorded in packed headers
+enum { LEVEL_UNKNOWN, LEVEL_DEBUG, LEVEL_N00B, LEVEL_L33T };
+
+// tags of indexed boards: solved by singles alone, symmetric givens, solved
+// by logic alone (see gradeLogic in puzzle.h)
+#define TAG_SINGLES 0x01
+#define TAG_SYMMETRIC 0x02
+#define TAG_LOGIC 0x04
+
+typedef struct {
+    // the mapped file, or NULL if the store isn't open
+    const unsigned char *data;
+    size_t size;
+
+    // STORE_RAW or STORE_PACKED
+    int format;
+
+    // LEVEL_* from the header (LEVEL_UNKNOWN for raw files)
+    int level;
+
+    // number of boards in the file
+    int count;
+
+    // where the first board starts, and bytes from one board to the next
+    const unsigned char *boards;
+    size_t stride;
+
+    // bucket table of an indexed file (NULL otherwise), and the order of its
+    // boards by difficulty (NULL if they're stored in that order)
+    const unsigned char *index;
+    const unsigned char *order;
+} store;
+
+// maps the file at path, returning 0 if missing or of unexpected size
+int store_open(store *s, const char *path);
+
+// unmaps the file
+void store_close(store *s);
+
+// board n of a raw store, counting from 1, as CELLS ints in row order
+// (NULL if out of range or if the store is packed)
+const int32_t *store_board(const store *s, int n);
+
+// copies board n, counting from 1, into board; returns 0 if out of range
+// or corrupt
+int store_read(const store *s, int n, int board[N][N]);
+
+// board n's difficulty (0 to PACK_BUCKETS - 1) and TAG_* bits, or -1 if
+// out of range or the store isn't indexed
+int store_difficulty(const store *s, int n);
+int store_tags(const store *s, int n);
+
+// number of a board with difficulty in [lo, hi], chosen by r (e.g. rand());
+// 0 if there's none. Stores without an index pick among all their boards
+int store_pick(const store *s, int lo, int hi, unsigned r);
+
+// writes every board of s to path in the indexed packed format, grading
+// them; boards keep their order (and numbers), only the index's order is
+// sorted by difficulty. Returns 0 on failure, leaving path as it was
+int store_pack(const store *s, const char *path, int level);
+
+// LEVEL_* for "debug", "n00b" or "l33t" (LEVEL_UNKNOWN otherwise)
+int store_level(const char *name);
+
+#endif
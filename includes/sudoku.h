@@ -7,12 +7,82 @@
  * Compile-time options for the game of Sudoku.
  ***************************************************************************/
 
+#ifndef SUDOKU_H
+#define SUDOKU_H
+
 // game's author
 #define AUTHOR "Mateus Ribeiro Bossa"
 
 // game's title
 #define TITLE "Sudoku CC50"
 
+// size of each box: 2, 3, 4 or 5 for 4x4, 9x9, 16x16 or 25x25 boards
+// (e.g. make clean && make BOX=4)
+#ifndef BOX
+#define BOX 3
+#endif
+
+// board's width (and number of digits), and number of cells; SIZE goes
+// between a level's name and the extension of its files, e.g. n00b.bin or
+// n00b.16x16.bin, and SYMBOLS are how digits 1 to N are shown and typed
+// (skipping the N, Q and R keys)
+#if BOX == 2
+#define N 4
+#define SIZE ".4x4"
+#elif BOX == 3
+#define N 9
+#define SIZE ""
+#elif BOX == 4
+#define N 16
+#define SIZE ".16x16"
+#elif BOX == 5
+#define N 25
+#define SIZE ".25x25"
+#else
+#error "BOX must be 2, 3, 4 or 5"
+#endif
+#define CELLS (N * N)
+#define SYMBOLS "123456789ABCDEFGHIJKLMOPS"
+
+// digit sets as masks, bit d for digit d
+#if N < 16
+typedef unsigned short digit_mask;
+#else
+typedef unsigned int digit_mask;
+#endif
+
+// a board as one byte per cell, row by row (0 if empty): being plain data,
+// a snapshot of it is an assignment or a memcpy
+typedef struct {
+    unsigned char cell[CELLS];
+} compact_board;
+
+// a set of cells, bit i for cell i (e.g. a board's givens)
+typedef struct {
+    unsigned long long bits[(CELLS + 63) / 64];
+} cell_set;
+
+#define CELL_ADD(s, i) ((s)->bits[(i) / 64] |= 1ULL << ((i) % 64))
+#define CELL_HAS(s, i) (((s)->bits[(i) / 64] >> ((i) % 64)) & 1)
+
+// size of each int (in bytes) in *.bin files
+#define INTSIZE 4
+
+// where moves are logged (see includes/movelog.h for the format)
+#define LOGFILE "moves.log"
+
+// suffix of the solution cache's sidecar file, e.g. l33t.sol next to l33t.bin
+// (comment out to keep solutions in memory only)
+#define SIDECAR ".sol"
+
+// count the solvers' internals and time each phase of starting a board,
+// shown on a debug panel (Ctrl-D) and dumped to STATSFILE as JSON on exit
+// (make clean && make STATS=1); without it, those counters compile away
+#ifndef STATS
+#define STATS 0
+#endif
+#define STATSFILE "stats.json"
+
 // banner's colors
 #define FG_BANNER COLOR_CYAN
 #define BG_BANNER COLOR_BLACK
@@ -31,3 +101,5 @@
 
 // nicknames for pairs of colors
 enum { PAIR_BANNER = 1, PAIR_GRID, PAIR_BORDER, PAIR_LOGO };
+
+#endif
@@ -0,0 +1,331 @@
+/****************************************************************************
+ * load.c
+ *
+ * CC 50
+ * Pset 4
+ *
+ * Load test for sudoku-server: many players at once on one epoll loop,
+ * each starting a game, solving it locally and sending every move of the
+ * solution in one go, then starting over, until all games are played.
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include "includes/puzzle.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// longest reply, in bytes (newline included), and most bytes of one game's requests
+#define REPLY (CELLS + 32)
+#define REQUESTS (CELLS * 16)
+
+// a player
+typedef struct {
+    int fd;
+
+    // requests not yet written
+    char out[REQUESTS];
+    size_t queued, sent;
+
+    // replies read but not yet complete
+    char in[REPLY];
+    size_t got;
+
+    // replies the current game still waits for, when it started (in us),
+    // and whether any reply was wrong
+    int waiting;
+    double started;
+    int wrong;
+} player;
+
+// where to connect
+static int port;
+static const char *path;
+
+// every game's time from NEW to WON (in us)
+static double *latencies;
+static int played, wanted, failed;
+static long moves;
+
+
+static double now_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static int compare(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Returns a connected (non-blocking) socket, or -1
+*/
+
+static int dial(void) {
+    int fd;
+    if(path != NULL) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+            goto fail;
+        }
+    } else {
+        struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+            goto fail;
+        }
+    }
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+
+fail:
+    if(fd >= 0) {
+        close(fd);
+    }
+    return -1;
+}
+
+/*
+ * Writes as much of p's requests as the socket takes; returns 0 if the
+ * connection is broken
+*/
+
+static int flush(player *p) {
+    while(p->sent < p->queued) {
+        ssize_t n = write(p->fd, p->out + p->sent, p->queued - p->sent);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 1;
+        }
+        if(n <= 0) {
+            return 0;
+        }
+        p->sent += n;
+    }
+    p->queued = p->sent = 0;
+    return 1;
+}
+
+static void request(player *p, const char *line) {
+    size_t len = strlen(line);
+    if(p->queued + len <= REQUESTS) {
+        memcpy(p->out + p->queued, line, len);
+        p->queued += len;
+    }
+}
+
+/*
+ * Starts p's next game, if any are left to start
+*/
+
+static void start(player *p, const char *level, int *started) {
+    if(*started == wanted) {
+        return;
+    }
+    (*started)++;
+    char line[32];
+    sprintf(line, "NEW %s\n", level);
+    request(p, line);
+    p->waiting = 1;
+    p->started = now_us();
+    p->wrong = 0;
+}
+
+/*
+ * Sends the moves that solve the board of a "BOARD # cells" reply; returns
+ * 0 if it can't be solved
+*/
+
+static int play(player *p, const char *line) {
+    int number;
+    char cells[CELLS + 1];
+    int board[N][N], givens[N][N];
+    if(sscanf(line, "BOARD %d %s", &number, cells) != 2 || strlen(cells) != CELLS) {
+        return 0;
+    }
+    for(int i = 0; i < CELLS; i++) {
+        const char *s = strchr(SYMBOLS, cells[i]);
+        givens[i / N][i % N] = board[i / N][i % N] = (cells[i] == '.' || s == NULL) ? 0 : s - SYMBOLS + 1;
+    }
+    if(!solveMask(board, NULL)) {
+        return 0;
+    }
+    for(int i = 0; i < CELLS; i++) {
+        if(givens[i / N][i % N] == 0) {
+            char move[32];
+            sprintf(move, "MOVE %d %d %c\n", i / N, i % N, SYMBOLS[board[i / N][i % N] - 1]);
+            request(p, move);
+            p->waiting++;
+            moves++;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Handles one reply: a board gets solved and its moves sent, and the last
+ * move's reply (which must say WON) ends the game
+*/
+
+static void answer(player *p, char *line, const char *level, int *started) {
+    p->waiting--;
+
+    int won = 0;
+    if(strncmp(line, "BOARD ", 6) == 0) {
+        p->wrong |= !play(p, line);
+    } else {
+        p->wrong |= strncmp(line, "OK", 2) != 0;
+        won = strstr(line, " WON") != NULL;
+    }
+
+    if(p->waiting == 0) {
+        if(won && !p->wrong) {
+            latencies[played++] = now_us() - p->started;
+        } else {
+            failed++;
+        }
+        start(p, level, started);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: sudoku-load [-c connections] [-g games] [-l level] port|socket-path\n";
+
+    int connections = 100;
+    const char *level = "n00b";
+    wanted = 10000;
+
+    int opt;
+    while((opt = getopt(argc, argv, "c:g:l:")) != -1) {
+        switch(opt) {
+            case 'c':
+                connections = atoi(optarg);
+                break;
+            case 'g':
+                wanted = atoi(optarg);
+                break;
+            case 'l':
+                level = optarg;
+                break;
+            default:
+                fprintf(stderr, usage);
+                return 1;
+        }
+    }
+    char c;
+    if(optind != argc - 1 || connections < 1 || wanted < 1) {
+        fprintf(stderr, usage);
+        return 1;
+    }
+    if(strchr(argv[optind], '/') != NULL) {
+        path = argv[optind];
+    } else if(sscanf(argv[optind], " %d %c", &port, &c) != 1 || port < 1 || port > 65535) {
+        fprintf(stderr, usage);
+        return 1;
+    }
+
+    latencies = malloc(wanted * sizeof(double));
+    player *players = calloc(connections, sizeof(player));
+    int epoll = epoll_create1(0);
+    if(latencies == NULL || players == NULL || epoll < 0) {
+        fprintf(stderr, "Out of memory!\n");
+        return 2;
+    }
+
+    double begin = now_us();
+    int started = 0, open = 0;
+    for(int i = 0; i < connections; i++) {
+        player *p = &players[i];
+        p->fd = dial();
+        if(p->fd < 0) {
+            fprintf(stderr, "Could not connect to %s!\n", argv[optind]);
+            return 3;
+        }
+        struct epoll_event e = { .events = EPOLLIN | EPOLLOUT, .data.ptr = p };
+        epoll_ctl(epoll, EPOLL_CTL_ADD, p->fd, &e);
+        start(p, level, &started);
+        open++;
+    }
+
+    struct epoll_event events[256];
+    while(played + failed < wanted && open > 0) {
+        int n = epoll_wait(epoll, events, 256, 5000);
+        if(n == 0) {
+            fprintf(stderr, "Server stopped answering!\n");
+            break;
+        }
+        for(int i = 0; i < n; i++) {
+            player *p = events[i].data.ptr;
+            if(p->fd < 0) {
+                continue;
+            }
+
+            // read every complete reply
+            ssize_t got = 1;
+            while(got > 0) {
+                got = read(p->fd, p->in + p->got, REPLY - p->got);
+                if(got > 0) {
+                    p->got += got;
+                }
+                char *end;
+                while((end = memchr(p->in, '\n', p->got)) != NULL) {
+                    *end = '\0';
+                    answer(p, p->in, level, &started);
+                    size_t used = end + 1 - p->in;
+                    memmove(p->in, end + 1, p->got - used);
+                    p->got -= used;
+                }
+            }
+            int broken = (got == 0) || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+
+            // done players, and ones that hung up, are closed
+            if(broken || !flush(p) || (p->waiting == 0 && p->queued == 0)) {
+                epoll_ctl(epoll, EPOLL_CTL_DEL, p->fd, NULL);
+                close(p->fd);
+                p->fd = -1;
+                open--;
+                continue;
+            }
+            struct epoll_event e = { .events = EPOLLIN | ((p->queued > 0) ? EPOLLOUT : 0), .data.ptr = p };
+            epoll_ctl(epoll, EPOLL_CTL_MOD, p->fd, &e);
+        }
+    }
+    double seconds = (now_us() - begin) / 1e6;
+
+    for(int i = 0; i < connections; i++) {
+        if(players[i].fd >= 0) {
+            close(players[i].fd);
+        }
+    }
+
+    printf("%d connections, %d games (%d failed) of %s in %.2f s\n", connections, played, failed, level, seconds);
+    printf("    %.0f games/s, %.0f moves/s\n", played / seconds, moves / seconds);
+    if(played > 0) {
+        qsort(latencies, played, sizeof(double), compare);
+        printf("    game latency us: min %.0f  median %.0f  p99 %.0f  max %.0f\n",
+               latencies[0], latencies[played / 2], latencies[(played * 99) / 100], latencies[played - 1]);
+    }
+
+    free(players);
+    free(latencies);
+    close(epoll);
+    return (failed > 0 || played < wanted) ? 4 : 0;
+}
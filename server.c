@@ -0,0 +1,549 @@
+/****************************************************************************
+ * server.c
+ *
+ * CC 50
+ * Pset 4
+ *
+ * Serves games of Sudoku to many players at once over a line protocol on
+ * a TCP port or a Unix socket. Every thread runs one epoll loop over its
+ * own connections (on TCP, each with its own SO_REUSEPORT listener, so the
+ * kernel spreads connections across threads), and a connection is just a
+ * session and two small buffers: there's no thread per player.
+ *
+ * Commands, one per line, each answered with one line:
+ *
+ *   NEW level [#]    starts a game of board # of level (debug, n00b or
+ *                    l33t), or of a random one: "BOARD # cells", the
+ *                    board's CELLS cells row by row as SYMBOLS, '.' if empty
+ *   MOVE y x digit   writes digit (one of SYMBOLS, or 0 to erase) into row
+ *                    y, column x (0 to N - 1): "OK", "CONFLICT", "GIVEN" or
+ *                    "INVALID", with " WON" added once the board is solved
+ *   SHOW             "BOARD # cells" of the game as played
+ *   QUIT             closes the connection
+ *
+ * Anything else is answered with "ERROR" and why.
+***************************************************************************/
+
+#define _GNU_SOURCE
+
+#include "includes/puzzle.h"
+#include "includes/cache.h"
+#include "includes/pool.h"
+#include "includes/session.h"
+#include "includes/store.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// longest command, and longest reply, in bytes (newline included)
+#define LINE 64
+#define REPLY (CELLS + 32)
+
+// replies buffered per connection while the player isn't reading them
+#define OUTPUT (4 * REPLY)
+
+// events handled per epoll_wait, and connections waiting to be accepted
+#define EVENTS 256
+#define BACKLOG 1024
+
+// a player's connection
+typedef struct {
+    int fd;
+
+    // the player's game (no board until their first NEW)
+    session game;
+    bool playing;
+
+    // bytes read but not yet answered, and replies not yet written
+    char in[LINE];
+    size_t got;
+    char out[OUTPUT];
+    size_t queued;
+
+    // events epoll watches for, and whether the connection is done
+    unsigned events;
+    bool closing;
+} client;
+
+// one thread's event loop
+typedef struct {
+    pthread_t thread;
+    int epoll;
+    int listener;
+
+    // for random boards
+    unsigned seed;
+
+    // connections open now, and commands answered so far
+    long clients, commands;
+} loop;
+
+// the levels served, each with its boards and solutions (shared by every loop)
+static struct {
+    const char *name;
+    store boards;
+    cache solutions;
+    pthread_mutex_t lock;
+} levels[] = { { "debug" }, { "n00b" }, { "l33t" } };
+
+#define LEVELS (int) (sizeof(levels) / sizeof(levels[0]))
+
+// where to listen: a TCP port, or a Unix socket's path
+static int port;
+static const char *path;
+
+// set by SIGINT and SIGTERM
+static volatile sig_atomic_t stopping;
+
+
+/*
+ * Returns a listening socket, or -1 on failure. TCP listeners share their
+ * port with every other loop's
+*/
+
+static int listen_on(void) {
+    int fd;
+    if(path != NULL) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        if(strlen(path) >= sizeof(addr.sun_path)) {
+            return -1;
+        }
+        strcpy(addr.sun_path, path);
+        unlink(path);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if(fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+            goto fail;
+        }
+    } else {
+        struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+        int on = 1;
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if(fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+           setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0 ||
+           bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+            goto fail;
+        }
+    }
+    if(listen(fd, BACKLOG) != 0) {
+        goto fail;
+    }
+    return fd;
+
+fail:
+    if(fd >= 0) {
+        close(fd);
+    }
+    return -1;
+}
+
+/*
+ * Queues a reply (without its newline) for c
+*/
+
+static void reply(client *c, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void reply(client *c, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(c->out + c->queued, OUTPUT - c->queued - 1, fmt, ap);
+    va_end(ap);
+    if(n < 0 || (size_t) n >= OUTPUT - c->queued - 1) {
+        n = OUTPUT - c->queued - 2;
+    }
+    c->queued += n;
+    c->out[c->queued++] = '\n';
+}
+
+/*
+ * Queues "BOARD # cells" of c's game
+*/
+
+static void reply_board(client *c) {
+    char cells[CELLS + 1];
+    for(int i = 0; i < CELLS; i++) {
+        int num = c->game.board.cell[i];
+        cells[i] = (num == 0) ? '.' : SYMBOLS[num - 1];
+    }
+    cells[CELLS] = '\0';
+    reply(c, "BOARD %d %s", c->game.number, cells);
+}
+
+/*
+ * Starts c on board number (a random one if 0) of level
+*/
+
+static void start_game(loop *l, client *c, const char *level, int number) {
+    int k = 0;
+    while(k < LEVELS && strcmp(level, levels[k].name) != 0) {
+        k++;
+    }
+    if(k == LEVELS || levels[k].boards.data == NULL) {
+        reply(c, "ERROR no such level");
+        return;
+    }
+    if(number == 0) {
+        number = store_pick(&levels[k].boards, 0, PACK_BUCKETS - 1, rand_r(&l->seed));
+    }
+
+    int cells[N][N];
+    compact_board board;
+    if(!store_read(&levels[k].boards, number, cells) || !compactBoard(&board, cells)) {
+        reply(c, "ERROR no such board");
+        return;
+    }
+    session_start(&c->game, number, &board);
+    c->playing = true;
+
+    // solutions come from the level's cache, else are worked out right here
+    // (well under a millisecond on 9x9 boards)
+    compact_board solution;
+    pthread_mutex_lock(&levels[k].lock);
+    int cached = cache_get(&levels[k].solutions, number, &board, &solution);
+    pthread_mutex_unlock(&levels[k].lock);
+    if(!cached) {
+        solution = board;
+        cached = solveCompact(ENGINE_MASK, &solution, NULL);
+        if(cached) {
+            pthread_mutex_lock(&levels[k].lock);
+            cache_put(&levels[k].solutions, number, &solution);
+            pthread_mutex_unlock(&levels[k].lock);
+        }
+    }
+    if(cached) {
+        session_solve(&c->game, &solution);
+    }
+    reply_board(c);
+}
+
+/*
+ * Answers one command (its newline already stripped)
+*/
+
+static void handle(loop *l, client *c, char *line) {
+    static const char *results[] = {
+        [MOVE_OK] = "OK", [MOVE_CONFLICT] = "CONFLICT", [MOVE_GIVEN] = "GIVEN", [MOVE_INVALID] = "INVALID"
+    };
+
+    size_t len = strlen(line);
+    if(len > 0 && line[len - 1] == '\r') {
+        line[len - 1] = '\0';
+    }
+    l->commands++;
+
+    char word[8], level[8], symbol, extra;
+    int y, x, number = 0;
+    if(sscanf(line, "%7s", word) != 1) {
+        reply(c, "ERROR empty command");
+    } else if(strcmp(word, "NEW") == 0) {
+        int n = sscanf(line, "NEW %7s %d %c", level, &number, &extra);
+        if(n < 1 || n > 2 || number < 0) {
+            reply(c, "ERROR usage: NEW level [#]");
+        } else {
+            start_game(l, c, level, number);
+        }
+    } else if(strcmp(word, "MOVE") == 0) {
+        if(sscanf(line, "MOVE %d %d %c %c", &y, &x, &symbol, &extra) != 3) {
+            reply(c, "ERROR usage: MOVE y x digit");
+        } else if(!c->playing) {
+            reply(c, "ERROR no game (NEW first)");
+        } else {
+            int result = session_move(&c->game, y, x, session_symbol(symbol));
+            reply(c, "%s%s", results[result], session_won(&c->game) ? " WON" : "");
+        }
+    } else if(strcmp(word, "SHOW") == 0) {
+        if(!c->playing) {
+            reply(c, "ERROR no game (NEW first)");
+        } else {
+            reply_board(c);
+        }
+    } else if(strcmp(word, "QUIT") == 0) {
+        c->closing = true;
+    } else {
+        reply(c, "ERROR unknown command");
+    }
+}
+
+/*
+ * Answers every complete line read so far, as long as there's room for the
+ * replies
+*/
+
+static void serve(loop *l, client *c) {
+    char *end;
+    while(!c->closing && OUTPUT - c->queued >= REPLY && (end = memchr(c->in, '\n', c->got)) != NULL) {
+        *end = '\0';
+        handle(l, c, c->in);
+
+        size_t used = end + 1 - c->in;
+        memmove(c->in, end + 1, c->got - used);
+        c->got -= used;
+    }
+
+    // a line too long for the buffer can't be a command
+    if(!c->closing && c->got == LINE && memchr(c->in, '\n', c->got) == NULL) {
+        reply(c, "ERROR line too long");
+        c->closing = true;
+    }
+}
+
+/*
+ * Writes as much of c's replies as the socket takes. Returns 0 if the
+ * connection is broken
+*/
+
+static int flush(client *c) {
+    size_t sent = 0;
+    while(sent < c->queued) {
+        ssize_t n = write(c->fd, c->out + sent, c->queued - sent);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if(n <= 0) {
+            return 0;
+        }
+        sent += n;
+    }
+    memmove(c->out, c->out + sent, c->queued - sent);
+    c->queued -= sent;
+    return 1;
+}
+
+static void drop(loop *l, client *c) {
+    epoll_ctl(l->epoll, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c);
+    l->clients--;
+}
+
+/*
+ * Reads from c while there's room, if it's readable, answers what it can
+ * and writes the replies, then watches for whatever c waits for: input
+ * while there's room for it and its replies, output while replies are left
+*/
+
+static void update(loop *l, client *c, unsigned ready) {
+    if(ready & (EPOLLERR | EPOLLHUP)) {
+        drop(l, c);
+        return;
+    }
+    while((ready & EPOLLIN) && !c->closing && c->got < LINE) {
+        ssize_t n = read(c->fd, c->in + c->got, LINE - c->got);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if(n <= 0) {
+            c->closing = true;
+            break;
+        }
+        c->got += n;
+        serve(l, c);
+    }
+    serve(l, c);
+
+    if(!flush(c) || (c->closing && c->queued == 0)) {
+        drop(l, c);
+        return;
+    }
+
+    unsigned events = 0;
+    if(c->queued > 0) {
+        events |= EPOLLOUT;
+    }
+    if(!c->closing && c->got < LINE && OUTPUT - c->queued >= REPLY) {
+        events |= EPOLLIN;
+    }
+    if(events != c->events) {
+        struct epoll_event e = { .events = events, .data.ptr = c };
+        epoll_ctl(l->epoll, EPOLL_CTL_MOD, c->fd, &e);
+        c->events = events;
+    }
+}
+
+/*
+ * Accepts every connection waiting on the loop's listener
+*/
+
+static void accept_all(loop *l) {
+    for(;;) {
+        int fd = accept4(l->listener, NULL, NULL, SOCK_NONBLOCK);
+        if(fd < 0) {
+            // EAGAIN once there's nobody left (or another loop got them first)
+            return;
+        }
+        client *c = calloc(1, sizeof(client));
+        if(c == NULL) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        struct epoll_event e = { .events = c->events, .data.ptr = c };
+        if(epoll_ctl(l->epoll, EPOLL_CTL_ADD, fd, &e) != 0) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        l->clients++;
+    }
+}
+
+/*
+ * A loop's thread: serves its connections until the server stops
+*/
+
+static void *run(void *arg) {
+    loop *l = arg;
+    struct epoll_event events[EVENTS];
+
+    while(!stopping) {
+        // wake up every second to notice the server stopping
+        int n = epoll_wait(l->epoll, events, EVENTS, 1000);
+        for(int i = 0; i < n; i++) {
+            if(events[i].data.ptr == NULL) {
+                accept_all(l);
+            } else {
+                update(l, events[i].data.ptr, events[i].events);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void handle_signal(int signum) {
+    stopping = 1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *usage = "Usage: sudoku-server [-t threads] port|socket-path\n";
+
+    int threads = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "t:")) != -1) {
+        switch(opt) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, usage);
+                return 1;
+        }
+    }
+    if(optind != argc - 1) {
+        fprintf(stderr, usage);
+        return 1;
+    }
+
+    // a path has a slash in it (e.g. ./sudoku.sock); anything else is a port
+    char c;
+    if(strchr(argv[optind], '/') != NULL) {
+        path = argv[optind];
+    } else if(sscanf(argv[optind], " %d %c", &port, &c) != 1 || port < 1 || port > 65535) {
+        fprintf(stderr, usage);
+        return 1;
+    }
+    if(threads <= 0) {
+        threads = pool_cores();
+    }
+
+    // map every level there's a file for
+    int served = 0;
+    for(int k = 0; k < LEVELS; k++) {
+        char filename[strlen(levels[k].name) + strlen(SIZE) + 5];
+        sprintf(filename, "%s%s.bin", levels[k].name, SIZE);
+        if(!store_open(&levels[k].boards, filename)) {
+            continue;
+        }
+#ifdef SIDECAR
+        char sidecar[strlen(levels[k].name) + strlen(SIZE) + strlen(SIDECAR) + 1];
+        sprintf(sidecar, "%s%s%s", levels[k].name, SIZE, SIDECAR);
+#else
+        char *sidecar = NULL;
+#endif
+        cache_open(&levels[k].solutions, levels[k].boards.count, sidecar);
+        pthread_mutex_init(&levels[k].lock, NULL);
+        served++;
+    }
+    if(served == 0) {
+        fprintf(stderr, "Could not load boards from disk!\n");
+        return 2;
+    }
+
+    // a player hanging up mid-write is just a closed connection
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    // Unix sockets have a single listener, which every loop watches (waking
+    // only one of them per connection)
+    int shared = -1;
+    if(path != NULL && (shared = listen_on()) < 0) {
+        fprintf(stderr, "Could not listen on %s!\n", path);
+        return 3;
+    }
+
+    loop *loops = calloc(threads, sizeof(loop));
+    int started = 0;
+    for(int t = 0; t < threads; t++) {
+        loop *l = &loops[t];
+        l->seed = time(NULL) + t;
+        l->listener = (shared >= 0) ? shared : listen_on();
+        l->epoll = epoll_create1(0);
+        struct epoll_event e = { .events = EPOLLIN | ((shared >= 0) ? EPOLLEXCLUSIVE : 0), .data.ptr = NULL };
+        if(l->listener < 0 || l->epoll < 0 || epoll_ctl(l->epoll, EPOLL_CTL_ADD, l->listener, &e) != 0 ||
+           pthread_create(&l->thread, NULL, run, l) != 0) {
+            fprintf(stderr, "Could not listen on %s!\n", argv[optind]);
+            stopping = 1;
+            break;
+        }
+        started++;
+    }
+    if(started == threads) {
+        fprintf(stderr, "Serving %d level(s) on %s%s with %d thread(s)\n", served,
+                (path != NULL) ? path : "port ", (path != NULL) ? "" : argv[optind], threads);
+    }
+
+    long commands = 0;
+    for(int t = 0; t < started; t++) {
+        pthread_join(loops[t].thread, NULL);
+        commands += loops[t].commands;
+    }
+    for(int t = 0; t < threads; t++) {
+        if(loops[t].epoll > 0) {
+            close(loops[t].epoll);
+        }
+        if(shared < 0 && loops[t].listener > 0) {
+            close(loops[t].listener);
+        }
+    }
+    if(shared >= 0) {
+        close(shared);
+        unlink(path);
+    }
+    free(loops);
+
+    for(int k = 0; k < LEVELS; k++) {
+        cache_close(&levels[k].solutions);
+        store_close(&levels[k].boards);
+    }
+    fprintf(stderr, "Answered %ld commands\n", commands);
+    return (started == threads) ? 0 : 3;
+}
@@ -9,6 +9,13 @@
 
 #include "includes/sudoku.h"
 #include "includes/puzzle.h"
+#include "includes/batch.h"
+#include "includes/cache.h"
+#include "includes/movelog.h"
+#include "includes/pool.h"
+#include "includes/session.h"
+#include "includes/stats.h"
+#include "includes/store.h"
 
 #include <ctype.h>
 #include <ncurses.h>
@@ -23,42 +30,106 @@
 // macro for processing control characters
 #define CTRL(x) ((x) & ~0140)
 
-// size of each int (in bytes) in *.bin files
-#define INTSIZE 4
+// grid's size on screen (in characters): borders around every box, cells two columns apart
+#define GRID_WIDTH (2 * N + 2 * BOX + 1)
+#define GRID_HEIGHT (N + BOX + 1)
+
+// debug panel's rows (relative to the grid's top), under the logo and clear of the banner
+#define PANEL_TOP ((GRID_HEIGHT + 3 > 15) ? 10 : GRID_HEIGHT + 4)
+#define PANEL_LINES 6
+
+// sessions (and replays of moves.log) know the arrow keys by these codes
+#if KEY_UP != SESSION_UP || KEY_DOWN != SESSION_DOWN || KEY_LEFT != SESSION_LEFT || KEY_RIGHT != SESSION_RIGHT
+#error "ncurses' arrow keys differ from the session's"
+#endif
 
 
 // wrapper for our game's globals
 struct {
     // the current level
     char *level;           
-     
-    // the game's board
-    int board[9][9];
 
-    // solved board
-    int solved_board[9][9];
+    // the solver engine (ENGINE_*)
+    int engine;
+
+    // difficulties new boards are picked from (indexed level files only)
+    int easiest, hardest;
 
-    // copy of the game's board
-    int copy_board[9][9];
-   
-    // the board's number
+    // the level's boards, mapped once at startup
+    store boards;
+
+    // solutions of the level's boards solved so far
+    cache solutions;
+
+    // log of the current game's moves
+    movelog log;
+     
+    // the game being played
+    session game;
+
+    // the solver task on the shared pool (if solving), the flag that calls
+    // it off, the board (and its number) it solves in place, and whether it
+    // found a solution
+    future solver;
+    bool solving;
+    int solver_cancel;
+    compact_board solver_board;
+    int solver_number;
+    int solver_solved;
+
+    // the number of the board to (re)start
     int number;
 
     // the board's top-left coordinates
     int top, left;
 
-    // the cursor's current location between (0,0) and (8,8)
-    int y, x;
+    // whether a hint is on the banner, the board the last hint was for, and
+    // how many hints in a row only eliminated candidates on it
+    bool hinting;
+    compact_board hinted;
+    int eliminations;
+
+    // set by handle_signal when the window has been resized
+    volatile sig_atomic_t resized;
+
+#if STATS
+    // every board's solver counters and phase times, the current board's
+    // record (NULL if it couldn't be added), and whether they're on screen
+    stats_log stats;
+    board_stats *timing;
+    bool debugging;
+
+    // when restart_game's current phase started (in ms)
+    double phase_start;
+
+    // the solver task's counters, how long it took (in ms), and its board's
+    // record in stats (-1 if none)
+    solve_stats solver_stats;
+    double solver_ms;
+    int solver_record;
+#endif
 } g;
 
+// STATS builds time each phase of restart_game (PHASE_*)
+#if STATS
+#define PHASE_DONE(p) phase_done(p)
+#else
+#define PHASE_DONE(p) ((void) 0)
+#endif
+
 
 // prototypes
 void draw_grid(void);
 void draw_borders(void);
 void draw_logo(void);
 void draw_numbers(void);
+void draw_stats(void);
+void hide_stats(void);
+void phase_done(int phase);
+void draw_dirty(void);
+void present(void);
 void hide_banner(void);
-bool load_board(void);
+bool load_board(compact_board *board);
 void handle_signal(int signum);
 void log_move(int ch);
 void redraw_all(void);
@@ -70,12 +141,14 @@ bool startup(void);
 
 void player_move(int ch);
 void player_choice(int ch, WINDOW *win);
+void player_hint(void);
 
-int mySameColumn(int x, int y, int num);
-int mySameSquare(int x, int y, int num);
-int mySameRow(int x, int y, int num);
+void start_solver(void);
+void run_solver(void *arg);
+void record_solver(int from);
+void check_solver(void);
+void stop_solver(void);
 
-int winCheck(void);
 void congratulations(WINDOW *win);
 
 /*
@@ -84,7 +157,103 @@ void congratulations(WINDOW *win);
 
 int main(int argc, char *argv[]) {
     // define usage
-    const char *usage = "Usage: sudoku n00b|l33t [#]\n";
+    const char *usage = "Usage: sudoku [--engine backtrack|mask|dlx|parallel] [--difficulty MIN-MAX] n00b|l33t [#]\n"
+                        "       sudoku [--engine backtrack|mask|dlx|parallel] --solve-all FILE.bin [OUT.bin]\n"
+                        "       sudoku [--engine mask|dlx|parallel] --audit FILE.bin [CAP]\n"
+                        "       sudoku --validate FILE.bin [avx2|sse2|scalar]\n"
+                        "       sudoku --grade FILE.bin\n"
+                        "       sudoku [--seed N] --generate n00b|l33t COUNT OUT.bin\n"
+                        "       sudoku --pack FILE.bin OUT.bin\n"
+                        "       sudoku --replay LOG ...\n";
+
+    // choose solver engine, if asked to
+    g.engine = ENGINE_MASK;
+    if (argc >= 3 && strcmp(argv[1], "--engine") == 0) {
+        g.engine = engineByName(argv[2]);
+        if (g.engine < 0) {
+            fprintf(stderr, usage);
+            return 1;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    // choose range of difficulties, if asked to
+    g.easiest = 0;
+    g.hardest = PACK_BUCKETS - 1;
+    if (argc >= 3 && strcmp(argv[1], "--difficulty") == 0) {
+        char c;
+        if (sscanf(argv[2], " %d - %d %c", &g.easiest, &g.hardest, &c) != 2 || g.easiest > g.hardest) {
+            fprintf(stderr, usage);
+            return 1;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+
+    // seed the generator, if asked to
+    unsigned long long seed;
+    bool seeded = false;
+    if (argc >= 3 && strcmp(argv[1], "--seed") == 0) {
+        char c;
+        if (sscanf(argv[2], " %llu %c", &seed, &c) != 1) {
+            fprintf(stderr, usage);
+            return 1;
+        }
+        seeded = true;
+        argc -= 2;
+        argv += 2;
+    }
+
+    // headless mode: solve a whole file of boards
+    if (argc >= 3 && argc <= 4 && strcmp(argv[1], "--solve-all") == 0) {
+        return solve_all(argv[2], (argc == 4) ? argv[3] : NULL, g.engine);
+    }
+
+    // headless mode: find boards without exactly one solution
+    if (argc >= 3 && argc <= 4 && strcmp(argv[1], "--audit") == 0) {
+        int cap = 2;
+        if (argc == 4 && (sscanf(argv[3], "%d", &cap) != 1 || cap < 2)) {
+            fprintf(stderr, usage);
+            return 1;
+        }
+        return audit_all(argv[2], cap, g.engine);
+    }
+
+    // headless mode: check every board's givens, many boards at a time
+    if (argc >= 3 && argc <= 4 && strcmp(argv[1], "--validate") == 0) {
+        if (argc == 4 && !batchUseKernel(argv[3])) {
+            fprintf(stderr, "Kernel %s is not supported on this CPU!\n", argv[3]);
+            return 1;
+        }
+        return validate_all(argv[2]);
+    }
+
+    // headless mode: grade every board by the techniques it takes
+    if (argc == 3 && strcmp(argv[1], "--grade") == 0) {
+        return grade_all(argv[2]);
+    }
+
+    // headless mode: make a new file of boards
+    if (argc == 5 && strcmp(argv[1], "--generate") == 0) {
+        int count;
+        char c;
+        if (sscanf(argv[3], " %d %c", &count, &c) != 1 || count < 1) {
+            fprintf(stderr, usage);
+            return 1;
+        }
+        return generate_all(argv[2], count, argv[4], seeded ? &seed : NULL);
+    }
+
+    // headless mode: convert a file of boards to the packed format
+    if (argc == 4 && strcmp(argv[1], "--pack") == 0) {
+        return pack_file(argv[2], argv[3]);
+    }
+
+    // headless mode: play logged games again and check every move
+    if (argc >= 3 && strcmp(argv[1], "--replay") == 0) {
+        return replay_all(argv + 2, argc - 2);
+    }
 
     // ensure that number of arguments is as expected
     if (argc != 2 && argc != 3) {
@@ -104,9 +273,16 @@ int main(int argc, char *argv[]) {
         return 2;
     }
 
-    // n00b and l33t levels have 1024 boards; debug level has 9
-    /* If Condition is true -> (strcmp(g.level, "debug") == 0) ? then value X (9) : otherwise value Y (1024) */
-    int max = (strcmp(g.level, "debug") == 0) ? 9 : 1024;
+    // map the level's boards
+    char filename[strlen(g.level) + strlen(SIZE) + 5];
+    sprintf(filename, "%s%s.bin", g.level, SIZE);
+    if (!store_open(&g.boards, filename)) {
+        fprintf(stderr, "Could not load board from disk!\n");
+        return 6;
+    }
+
+    // a level has as many boards as its file holds (shipped n00b and l33t have 1024; debug has 9)
+    int max = g.boards.count;
 
     // ensure that #, if provided, is in [1, max]
     if (argc == 3) {
@@ -114,12 +290,14 @@ int main(int argc, char *argv[]) {
         char c;
         if (sscanf(argv[2], " %d %c", &g.number, &c) != 1) {
             fprintf(stderr, usage);
+            store_close(&g.boards);
             return 3;
         }
 
         // ensure n is in [1, max]
         if (g.number < 1 || g.number > max) {
             fprintf(stderr, "That board # does not exist!\n");
+            store_close(&g.boards);
             return 4;
         }
 
@@ -130,10 +308,30 @@ int main(int argc, char *argv[]) {
         // seed PRNG with current time so that we get any sequence of boards
         srand(time(NULL));
 
-        // choose a random n in [1, max]
-        g.number = rand() % max + 1;
+        // choose a random n in [1, max], within the range of difficulties
+        g.number = store_pick(&g.boards, g.easiest, g.hardest, rand());
+        if (g.number == 0) {
+            fprintf(stderr, "No board of that difficulty!\n");
+            store_close(&g.boards);
+            return 7;
+        }
     }
 
+    // open the level's solution cache
+#ifdef SIDECAR
+    char sidecar[strlen(g.level) + strlen(SIZE) + strlen(SIDECAR) + 1];
+    sprintf(sidecar, "%s%s%s", g.level, SIZE, SIDECAR);
+#else
+    char *sidecar = NULL;
+#endif
+    cache_open(&g.solutions, g.boards.count, sidecar);
+
+    // open log (the game goes on without one if it can't be created)
+    movelog_open(&g.log, LOGFILE);
+
+    // boards get solved on the shared pool, one at a time
+    future_init(&g.solver);
+
     // start up ncurses
     if (!startup()) {
         fprintf(stderr, "Error starting up ncurses!\n");
@@ -169,8 +367,16 @@ int main(int argc, char *argv[]) {
     // let the user play!
     int ch;
     do {
-        // refresh the screen       
-        refresh();      
+        // the window was resized: start the screen over
+        if (g.resized) {
+            g.resized = 0;
+            endwin();
+            refresh();
+            redraw_all();
+        }
+
+        // send this frame's changes to the screen all at once
+        present();
 
         // get user's input
         ch = getch(); 
@@ -178,17 +384,29 @@ int main(int argc, char *argv[]) {
         // capitalize input to simplify cases
         ch = toupper(ch);
 
+        // a hint stays up until the next keypress
+        if (g.hinting && ch != ERR) {
+            hide_banner();
+            g.hinting = false;
+        }
+
         // always erases congratulations window if it exists after getting the char
              
 
         // if number or dot is pressed
-        if(ch >= '0' && ch <= '9') {         
+        if(session_symbol(ch) >= 0) {         
             player_choice(ch, winErr);
         } 
 
-        refresh();
+        // pick up the solution if the solver task has just finished
+        check_solver();
         
-        if(!winCheck()) {    // checks current states of board and compares with solved board            
+        if(session_won(&g.game)) {    // checks current states of board and compares with solved board            
+            // log the winning move now: keys pressed while the banner is up aren't logged
+            if (ch != ERR) {
+                log_move(ch);
+            }
+
             congratulations(winWindow);
             if (has_colors()) {
                 init_pair(1, COLOR_GREEN, COLOR_BLACK);                
@@ -200,6 +418,7 @@ int main(int argc, char *argv[]) {
                 attroff(COLOR_PAIR(1));
                 attroff(A_BLINK);
             }
+            present();
             int cont = 0;
             do {                
                 ch = getch();
@@ -222,7 +441,7 @@ int main(int argc, char *argv[]) {
                 }
             } while (cont != 1);
             werase(winWindow);
-            wrefresh(winWindow);
+            wnoutrefresh(winWindow);
             curs_set(2);            
         }        
         
@@ -230,7 +449,7 @@ int main(int argc, char *argv[]) {
         switch (ch) {
             // start a new game
             case 'N': 
-                g.number = rand() % max + 1;
+                g.number = store_pick(&g.boards, g.easiest, g.hardest, rand());
                 if (!restart_game()) {
                     shutdown();
                     fprintf(stderr, "Could not load board from disk!\n");
@@ -252,6 +471,18 @@ int main(int argc, char *argv[]) {
                 redraw_all();
                 break;
 
+#if STATS
+            // show or hide the solver's counters with ctrl-D
+            case CTRL('d'):
+                g.debugging = !g.debugging;
+                if (g.debugging) {
+                    draw_stats();
+                } else {
+                    hide_stats();
+                }
+                break;
+#endif
+
             // player movement
             case KEY_UP:
                 player_move(ch);
@@ -268,22 +499,46 @@ int main(int argc, char *argv[]) {
             case KEY_LEFT:
                 player_move(ch);
                 break;                                                                    
+
+            // show the next logical step
+            case '?':
+                player_hint();
+                break;
         }            
          
-        // log input (and board's state) if any was received this iteration
+        // log input (and board's changes) if any was received this iteration
         if (ch != ERR) {
             log_move(ch);
+        } else {
+            movelog_poll(&g.log);
         }
     }
     while (ch != 'Q');
 
-    // shut down ncurses
+    // call the solver off, then shut down ncurses
+    stop_solver();
     shutdown();
+    future_destroy(&g.solver);
+    bool logged = movelog_close(&g.log);
+#if STATS
+    if (!stats_dump(&g.stats, STATSFILE, g.level, engineName(g.engine))) {
+        fprintf(stderr, "Could not write %s!\n", STATSFILE);
+    }
+    stats_free(&g.stats);
+#endif
+    cache_close(&g.solutions);
+    store_close(&g.boards);
 
     // tidy up the screen (using ANSI escape sequences)
     printf("\033[2J");
     printf("\033[%d;%dH", 0, 0);
 
+    // say so if moves.log lost any moves, below the cleared screen
+    if (!logged) {
+        fflush(stdout);
+        fprintf(stderr, "Could not write %s!\n", LOGFILE);
+    }
+
     // that's all folks
     printf("\nkthxbai!\n\n");
     return 0;
@@ -299,28 +554,36 @@ void draw_grid(void) {
     int maxy, maxx;
     getmaxyx(stdscr, maxy, maxx);
 
-    // determine where top-left corner of board belongs 
-    g.top = maxy/2 - 7;
-    g.left = maxx/2 - 30;
+    // determine where top-left corner of board belongs (grid and logo side by side)
+    g.top = maxy/2 - (GRID_HEIGHT + 1) / 2;
+    g.left = maxx/2 - (GRID_WIDTH + 35) / 2;
 
     // enable color if possible
     if (has_colors()) {
         attron(COLOR_PAIR(PAIR_GRID));
     }
 
+    // build the grid's lines, e.g. "+-------+" and "|       |" for 3x3 boxes
+    char border[GRID_WIDTH + 1], line[GRID_WIDTH + 1];
+    for (int i = 0; i < GRID_WIDTH; i++) {
+        border[i] = (i % (2 * BOX + 2) == 0) ? '+' : '-';
+        line[i] = (i % (2 * BOX + 2) == 0) ? '|' : ' ';
+    }
+    border[GRID_WIDTH] = line[GRID_WIDTH] = '\0';
+
     // print grid
-    for (int i = 0 ; i < 3 ; ++i) {
-        mvaddstr(g.top + 0 + 4 * i, g.left, "+-------+-------+-------+");
-        mvaddstr(g.top + 1 + 4 * i, g.left, "|       |       |       |");
-        mvaddstr(g.top + 2 + 4 * i, g.left, "|       |       |       |");
-        mvaddstr(g.top + 3 + 4 * i, g.left, "|       |       |       |");
+    for (int i = 0 ; i < BOX ; ++i) {
+        mvaddstr(g.top + (BOX + 1) * i, g.left, border);
+        for (int j = 1; j <= BOX; j++) {
+            mvaddstr(g.top + (BOX + 1) * i + j, g.left, line);
+        }
     }
-    mvaddstr(g.top + 4 * 3, g.left, "+-------+-------+-------+" );
+    mvaddstr(g.top + (BOX + 1) * BOX, g.left, border);
 
     // remind user of level and #
     char reminder[maxx+1];
     sprintf(reminder, "   playing %s #%d", g.level, g.number);
-    mvaddstr(g.top + 14, g.left + 25 - strlen(reminder), reminder);
+    mvaddstr(g.top + GRID_HEIGHT + 1, g.left + GRID_WIDTH - strlen(reminder), reminder);
 
     // disable color if possible
     if (has_colors()) {
@@ -357,7 +620,7 @@ void draw_borders(void) {
     mvaddstr(0, (maxx - strlen(header)) / 2, header);
 
     // draw footer
-    mvaddstr(maxy-1, 1, "[N]ew Game   [R]estart Game");
+    mvaddstr(maxy-1, 1, STATS ? "[N]ew Game   [R]estart Game   [?] Hint   [^D]ebug" : "[N]ew Game   [R]estart Game   [?] Hint");
     mvaddstr(maxy-1, maxx-13, "[Q]uit Game");
 
     // disable color if possible (else b&w highlighting)
@@ -377,7 +640,7 @@ void draw_borders(void) {
 void draw_logo(void) {
     // determine top-left coordinates of logo
     int top = g.top + 2;
-    int left = g.left + 30;
+    int left = g.left + GRID_WIDTH + 5;
 
     // enable color if possible
     if (has_colors()) {
@@ -410,15 +673,43 @@ void draw_logo(void) {
 */
 
 void draw_numbers(void) {
-    // iterate over board's numbers
-    for (int i = 0; i < 9; i++) {
-        for (int j = 0; j < 9; j++) {
+    // mark every number as changed
+    memset(&g.game.dirty, 0xFF, sizeof(g.game.dirty));
+    draw_dirty();
+}
+
+
+/*
+ * Draws the numbers changed since they were last drawn.  Nothing reaches
+ * the terminal until the frame is presented.
+*/
+
+void draw_dirty(void) {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            if (!CELL_HAS(&g.game.dirty, i * N + j)) {
+                continue;
+            }
             // determine char
-            char c = (g.board[i][j] == 0) ? '.' : g.board[i][j] + '0';
-            mvaddch(g.top + i + 1 + i/3, g.left + 2 + 2*(j + j/3), c);
-            refresh();
+            int value = g.game.board.cell[i * N + j];
+            char c = (value == 0) ? '.' : SYMBOLS[value - 1];
+            mvaddch(g.top + i + 1 + i/BOX, g.left + 2 + 2*(j + j/BOX), c);
         }
     }
+    memset(&g.game.dirty, 0, sizeof(g.game.dirty));
+}
+
+
+/*
+ * Ends a frame: draws changed numbers, puts the cursor back and updates the
+ * terminal once.  Other windows must have been wnoutrefresh'ed already.
+*/
+
+void present(void) {
+    draw_dirty();
+    show_cursor();
+    wnoutrefresh(stdscr);
+    doupdate();
 }
 
 
@@ -427,9 +718,9 @@ void draw_numbers(void) {
 */
 
 void handle_signal(int signum) {
-    // handle a change in the window (i.e., a resizing)
+    // handle a change in the window (i.e., a resizing) on the next frame
     if (signum == SIGWINCH) {
-        redraw_all();
+        g.resized = 1;
     }
     // re-register myself so this signal gets handled in future too
     signal(signum, (void (*)(int)) handle_signal);
@@ -447,74 +738,92 @@ void hide_banner(void) {
 
     // overwrite banner with spaces
     for (int i = 0; i < maxx; i++) {
-        mvaddch(g.top + 16, i, ' ');
+        mvaddch(g.top + GRID_HEIGHT + 3, i, ' ');
     }
 }
 
 
 /*
- * Loads current board from disk, returning true iff successful.
+ * Draws the debug panel (STATS builds, once toggled on with ctrl-D) under
+ * the logo: the current board's solver counters and phase times
 */
 
-bool load_board(void) {
-    // open file with boards of specified level
-    char filename[strlen(g.level) + 5];
-    sprintf(filename, "%s.bin", g.level);
-    FILE *fp = fopen(filename, "rb");
-    if (fp == NULL) {
-        return false;
+void draw_stats(void) {
+#if STATS
+    if (!g.debugging || g.timing == NULL) {
+        return;
     }
-    // determine file's size
-    fseek(fp, 0, SEEK_END);
-    int size = ftell(fp);
+    board_stats *b = g.timing;
+    const char *from = (b->from == FROM_CACHE) ? "cached" : (b->from == FROM_SOLVER) ? "solved" :
+                       (b->from == FROM_CANCELLED) ? "cancelled" : "unsolved";
+
+    char lines[PANEL_LINES][36];
+    snprintf(lines[0], 36, "#%d %s by %s in %.2f ms", b->number, from, engineName(g.engine), b->solver_ms);
+    snprintf(lines[1], 36, "calls %ld  depth %d", b->solver.calls, b->solver.depth);
+    snprintf(lines[2], 36, "guesses %ld  backtracks %ld", b->solver.guesses, b->solver.backtracks);
+    snprintf(lines[3], 36, "tests %ld", b->solver.tests);
+    snprintf(lines[4], 36, "load/solve/copy/draw ms:");
+    snprintf(lines[5], 36, "%.3f %.3f %.3f %.3f",
+             b->phase[PHASE_LOAD], b->phase[PHASE_SOLVE], b->phase[PHASE_COPY], b->phase[PHASE_DRAW]);
 
-    // ensure file is of expected size
-    if (size % (81 * INTSIZE) != 0) {
-        fclose(fp);
-        return false;
+    if (has_colors()) {
+        attron(COLOR_PAIR(PAIR_BANNER));
     }
+    for (int i = 0; i < PANEL_LINES; i++) {
+        mvprintw(g.top + PANEL_TOP + i, g.left + GRID_WIDTH + 5, "%-35s", lines[i]);
+    }
+    if (has_colors()) {
+        attroff(COLOR_PAIR(PAIR_BANNER));
+    }
+    show_cursor();
+#endif
+}
 
-    // compute offset of specified board
-    int offset = ((g.number - 1) * 81 * INTSIZE);
 
-    // seek to specified board
-    fseek(fp, offset, SEEK_SET);
+/*
+ * Hides the debug panel.
+*/
 
-    // read board into memory
-    if (fread(g.board, 81 * INTSIZE, 1, fp) != 1) {
-        fclose(fp);
-        return false;
+void hide_stats(void) {
+    for (int i = 0; i < PANEL_LINES; i++) {
+        mvprintw(g.top + PANEL_TOP + i, g.left + GRID_WIDTH + 5, "%35s", "");
     }
-
-    // w00t
-    fclose(fp);
-    return true;
+    show_cursor();
 }
 
 
 /*
- * Logs input and board's state to log.txt to facilitate automated tests.
+ * Ends restart_game's current phase (PHASE_*), timing it into the board's record
 */
 
-void log_move(int ch) {
-    // open log
-    FILE *fp = fopen("log.txt", "a");
-    if (fp == NULL) {
-        return;
+void phase_done(int phase) {
+#if STATS
+    double now = stats_ms();
+    if (g.timing != NULL) {
+        g.timing->phase[phase] = now - g.phase_start;
     }
-    // log input
-    fprintf(fp, "%d\n", ch);
+    g.phase_start = now;
+#endif
+}
 
-    // log board
-    for (int i = 0; i < 9; i++) {
-        for (int j = 0; j < 9; j++) {
-            fprintf(fp, "%d", g.board[i][j]);
-        }
-        fprintf(fp, "\n");
-    }
 
-    // that's it
-    fclose(fp);
+/*
+ * Loads current board from the level's store into board, returning true iff successful.
+*/
+
+bool load_board(compact_board *board) {
+    // copy specified board out of the mapped file (raw or packed)
+    int cells[N][N];
+    return store_read(&g.boards, g.number, cells) && compactBoard(board, cells);
+}
+
+
+/*
+ * Logs input and the cells it changed to LOGFILE to facilitate automated tests.
+*/
+
+void log_move(int ch) {
+    movelog_key(&g.log, ch, &g.game.board);
 }
 
 
@@ -523,11 +832,7 @@ void log_move(int ch) {
 */
 
 void redraw_all(void) {
-    // reset ncurses
-    endwin();
-    refresh();
-
-    // clear screen
+    // clear screen, so the next frame repaints all of it
     clear();
 
     // re-draw everything
@@ -535,6 +840,7 @@ void redraw_all(void) {
     draw_grid();
     draw_logo();
     draw_numbers();
+    draw_stats();
 
     // show cursor
     show_cursor();
@@ -546,45 +852,63 @@ void redraw_all(void) {
 */
 
 bool restart_game(void) {
+#if STATS
+    // a new record, timed phase by phase
+    g.timing = stats_add(&g.stats, g.number);
+    g.phase_start = stats_ms();
+#endif
+
     // reload current game
-    if (!load_board()) {
+    compact_board board;
+    if (!load_board(&board)) {
         return false;
     } 
+    PHASE_DONE(PHASE_LOAD);
     
-    // redraw board
+    // redraw board (numbers follow with the next frame)
     draw_grid();
-    draw_numbers();
+    PHASE_DONE(PHASE_DRAW);
 
     // get window's dimensions
     int maxy, maxx;
     getmaxyx(stdscr, maxy, maxx);
 
 
-    // creates copy of the game board for solving the puzzle
-    for(int i = 0; i < 9; i++) {
-       for(int j = 0; j < 9; j++) {
-           g.solved_board[i][j] = g.board[i][j];
-        }
+    // drop the previous board's solver, if it's still running; this board's
+    // own keeps going, and hands its solution to the new session
+    if (g.solver_number != g.number) {
+        stop_solver();
     }
 
-    // solves this level board and place it into g.solved_board
-    int x = 0;
-    int y = 0;
-    solveSudoku(x, y, g.solved_board);
-
-    // creates copy of the game level board that won't be changed, for later verification 
-    for(int i = 0; i < 9; i++) {
-       for(int j = 0; j < 9; j++) {
-           g.copy_board[i][j] = g.board[i][j];
-        }
-    }    
-
-    // move cursor to board's center
-    g.y = g.x = 4;
+    // start the game over (cursor at the board's center)
+    session_start(&g.game, g.number, &board);
     show_cursor();
+    PHASE_DONE(PHASE_COPY);
+
+    // looks this level board's solution up in the cache, else solves it on
+    // another thread (unless that's under way) and the session gets it later
+    compact_board solution;
+    if (cache_get(&g.solutions, g.number, &board, &solution)) {
+        session_solve(&g.game, &solution);
+#if STATS
+        if (g.timing != NULL) {
+            g.timing->from = FROM_CACHE;
+        }
+#endif
+    } else if (g.solving) {
+        // check_solver hands the running solver's solution to the new
+        // session, and its counters to the new record
+#if STATS
+        g.solver_record = (g.timing != NULL) ? (int) (g.timing - g.stats.boards) : -1;
+#endif
+    } else {
+        start_solver();
+    }
+    PHASE_DONE(PHASE_SOLVE);
+    draw_stats();
 
-    // remove log, if any
-    remove("log.txt");
+    // start log over for this game
+    movelog_start(&g.log, store_level(g.level), g.number, &board);
 
     // w00t
     return true;
@@ -592,12 +916,13 @@ bool restart_game(void) {
 
 
 /*
- * Shows cursor at (g.y, g.x).
+ * Shows cursor at the game's cursor.
 */
 
 void show_cursor(void) {
     // restore cursor's location
-    move(g.top + g.y + 1 + g.y/3, g.left + 2 + 2*(g.x + g.x/3));
+    int y = g.game.y, x = g.game.x;
+    move(g.top + y + 1 + y/BOX, g.left + 2 + 2*(x + x/BOX));
 }
 
 
@@ -613,7 +938,7 @@ void show_banner(char *b) {
     }
 
     // determine where top-left corner of board belongs 
-    mvaddstr(g.top + 16, g.left + 64 - strlen(b), b);
+    mvaddstr(g.top + GRID_HEIGHT + 3, g.left + GRID_WIDTH + 39 - strlen(b), b);
 
     // disable color if possible
     if (has_colors()) {
@@ -690,78 +1015,69 @@ bool startup(void) {
 
 void player_move(int ch) {
 
-    switch (ch) {
-        case KEY_UP:
-            if(g.y == 0) {
-                g.y = 8;
-                show_cursor();
-                break;
-            } else {
-                g.y--;
-                show_cursor();
-                break;
-            }                         
+    // the session wraps the cursor around the board's edges
+    session_key(&g.game, ch);
+    show_cursor();
+}
 
-        case KEY_DOWN:
-            if(g.y == 8) {
-                g.y = 0;
-                show_cursor();
-                break;
-            } else {
-                g.y++;
-                show_cursor();
-                break; 
-            }                
-        
-        case KEY_RIGHT:
-            if(g.x == 8) {
-                g.x = 0;
-                show_cursor();
-                break;
-            } else {
-                g.x++;
-                show_cursor(); 
-                break; 
-            }          
-
-        case KEY_LEFT:
-            if(g.x == 0) {
-                g.x = 8;
-                show_cursor();
-                break;
-            } else {
-                g.x--;
-                show_cursor(); 
-                break;
-            }
-            
-        default:
-            break;
+/*
+ * Player hint - shows the next step logic can take, and the cells it's about
+*/
+
+void player_hint(void) {
+    // logic works from the givens and the player's right cells (those that
+    // don't conflict while the solution isn't known yet)
+    int board[N][N];
+    bool solved = g.game.solution.cell[0] != 0;
+    for (int i = 0; i < CELLS; i++) {
+        int value = g.game.board.cell[i];
+        bool right = solved ? value == g.game.solution.cell[i] : !session_conflict(&g.game, i / N, i % N, value);
+        board[i / N][i % N] = (CELL_HAS(&g.game.givens, i) || (value != 0 && right)) ? value : 0;
+    }
+
+    // the player can't note eliminations, so asking again on the same board
+    // gets the step after them, up to the digit they lead to
+    if (memcmp(&g.hinted, &g.game.board, sizeof(compact_board)) != 0) {
+        g.hinted = g.game.board;
+        g.eliminations = 0;
     }
 
+    // the hint names its cells rather than moving the cursor there, which
+    // moves.log couldn't replay (the hint depends on when the solver is done)
+    logic_step hint;
+    char text[160] = "Hint: ";
+    if (hintLogic(board, g.eliminations, &hint)) {
+        explainStep(&hint, text + 6, sizeof(text) - 6);
+        g.eliminations = (hint.cell < 0) ? g.eliminations + 1 : 0;
+    } else {
+        strcat(text, "logic alone gets no further");
+    }
+
+    // the banner ends at the logo's right edge, so it can't be wider than that
+    int room = g.left + GRID_WIDTH + 39;
+    if (room >= 0 && room < (int) sizeof(text)) {
+        text[room] = '\0';
+    }
+    hide_banner();
+    show_banner(text);
+    g.hinting = true;
+    show_cursor();
 }
 
 /*
- * Player choice - enters here just if '1' to '9' or '.' is pressed, than adds the character to the cursor position
+ * Player choice - enters here just if one of the first N SYMBOLS or '0' is pressed, than adds the character to the cursor position
 */
 
 void player_choice(int ch, WINDOW *win) {
-    int value = ch - '0';
+    // the session marks the cell, which gets redrawn with the next frame
+    int result = session_key(&g.game, ch);
 
-    if(g.copy_board[g.y][g.x] == 0 && ch == '0') {
-        char dot = '.';
-        addch(dot);
-        show_cursor(); // so the cursor goes back to it's initial selected position after pressing the number
-        g.board[g.y][g.x] = 0;
-        werase(win);
-        wrefresh(win);
+    // the level's own numbers can't be changed
+    if(result == MOVE_GIVEN || result == MOVE_INVALID) {
+        return;
+    }
 
-    } else if((mySameColumn(g.y, g.x, value) || mySameRow(g.y, g.x, value) || mySameSquare(g.y, g.x, value)) && g.copy_board[g.y][g.x] == 0) {
-        
-        addch(ch);        
-        show_cursor();
-        g.board[g.y][g.x] = value;
-        
+    if(result == MOVE_CONFLICT) {
         box(win, 0, 0);
         if (has_colors()) {
             init_pair(1, COLOR_RED, COLOR_BLACK);                
@@ -770,121 +1086,143 @@ void player_choice(int ch, WINDOW *win) {
         mvwprintw(win, 1, 4, "NUMBER CAN'T BE THERE"); 
         if (has_colors()) {                       
             wattroff(win, COLOR_PAIR(1));
-            wrefresh(win);
         }           
-    } else if(g.copy_board[g.y][g.x] == 0) {        
-        addch(ch);        
-        show_cursor(); 
-        g.board[g.y][g.x] = value;
+        wnoutrefresh(win);
+    } else {        
         werase(win);
-        wrefresh(win);
+        wnoutrefresh(win);
     } 
-    
-      
-           
-
 }
 
 
 /*
- * Checks current g.board with g.solved_board and return 1 if solved and 0 if not
+ * Starts solving the game's givens on the shared pool; the game stays playable meanwhile
 */
 
-int winCheck(void) {
+void start_solver(void) {
+    // a previous board's solver may still be running
+    stop_solver();
 
-    for(int i = 0; i < 9; i++) {
-        for(int j = 0; j < 9; j++) {
-            if(g.board[i][j] != g.solved_board[i][j]){
-                return 1;
-            }
-        }
+    // only the givens: the player may have moved already
+    for(int i = 0; i < CELLS; i++) {
+        g.solver_board.cell[i] = CELL_HAS(&g.game.givens, i) ? g.game.board.cell[i] : 0;
+    }
+    g.solver_number = g.game.number;
+    g.solver_cancel = 0;
+    g.solving = true;
+#if STATS
+    g.solver_record = (g.timing != NULL) ? (int) (g.timing - g.stats.boards) : -1;
+#endif
+
+    // solve right here if the pool can't be started
+    pool *p = pool_shared();
+    if (p != NULL) {
+        pool_async(p, &g.solver, run_solver, NULL);
+    } else {
+        run_solver(NULL);
+        check_solver();
     }
-    return 0;
 }
 
+
 /*
- * Congratulations message if win
+ * Solver task: solves g.solver_board in place
 */
 
-void congratulations(WINDOW *winWindow) {
+void run_solver(void *arg) {
+#if STATS
+    double start = stats_ms();
+    g.solver_stats = (solve_stats) { .cancel = &g.solver_cancel };
+    g.solver_solved = solveCompact(g.engine, &g.solver_board, &g.solver_stats);
+    g.solver_ms = stats_ms() - start;
+#else
+    solve_stats stats = { .cancel = &g.solver_cancel };
+    g.solver_solved = solveCompact(g.engine, &g.solver_board, &stats);
+#endif
+}
 
-    box(winWindow, 0, 0);   
 
-    if (has_colors()) {
-        init_pair(1, COLOR_GREEN, COLOR_BLACK);                
-        wattron(winWindow, COLOR_PAIR(1));
-    }    
-    mvwprintw(winWindow, 1, 3, "CONGRATULATIONS, YOU WON!"); 
-    if (has_colors()) {                       
-        wattroff(winWindow, COLOR_PAIR(1));
-    }    
+/*
+ * Hands the solver task's solution to the game once it's done
+*/
 
-    mvwprintw(winWindow, 2, 5, "Press 'N', 'R' or 'Q'");      
-    wrefresh(winWindow);    
-      
-    curs_set(0);
+void check_solver(void) {
+    if (!g.solving || !future_ready(&g.solver)) {
+        return;
+    }
+    g.solving = false;
+
+    if (g.solver_solved) {
+        cache_put(&g.solutions, g.solver_number, &g.solver_board);
+        session_solve(&g.game, &g.solver_board);
+    }
 
+    // the board's record gets the solver's counters, solved or not
+    record_solver(g.solver_solved ? FROM_SOLVER : FROM_NOWHERE);
 }
 
+
 /*
- * Will return 1 (true) if the number we're passing already exists in the same column
+ * Calls the solver task off, if any, and waits for it to give up; a solution
+ * it found all the same is only cached, for when its board comes back
 */
 
-int mySameColumn(int x, int y, int num) {
-
-    for(int i = 0; i < 9; i++) {
-        if(g.board[x][i] == num) {
-            return 1;
-        }
+void stop_solver(void) {
+    if (!g.solving) {
+        return;
     }
+    bool done = future_ready(&g.solver);
+    if (!done) {
+        __atomic_store_n(&g.solver_cancel, 1, __ATOMIC_RELAXED);
+    }
+    future_wait(&g.solver);
+    g.solving = false;
 
-    return 0;
+    if (g.solver_solved) {
+        cache_put(&g.solutions, g.solver_number, &g.solver_board);
+    }
+    record_solver(g.solver_solved ? FROM_SOLVER : done ? FROM_NOWHERE : FROM_CANCELLED);
 }
 
+
 /*
- * Will return 1 (true) if the number we're passing already exists in the same row
+ * Gives the solver's board record (STATS builds) the solver task's counters,
+ * with where the board's solution came from (FROM_*)
 */
 
-int mySameRow(int x, int y, int num) {
-
-    for(int i = 0; i < 9; i++) {
-        if(g.board[i][y] == num) {
-            return 1;
-        }
+void record_solver(int from) {
+#if STATS
+    if (g.solver_record >= 0) {
+        board_stats *b = &g.stats.boards[g.solver_record];
+        b->from = from;
+        b->solver = g.solver_stats;
+        b->solver_ms = g.solver_ms;
     }
-
-    return 0;
+    draw_stats();
+#endif
 }
 
+
 /*
- * Will return 1 (true) if the number we're passing already exists in the same square
+ * Congratulations message if win
 */
 
-int mySameSquare(int x, int y, int num) {
+void congratulations(WINDOW *winWindow) {
 
-    if(x < 3) {
-        x = 0;
-    } else if(x < 6) {
-        x = 3;
-    } else {
-        x = 6;
-    }
+    box(winWindow, 0, 0);   
 
-    if(y < 3) {
-        y = 0;
-    } else if(y < 6) {
-        y = 3;
-    } else {
-        y = 6;
-    }
+    if (has_colors()) {
+        init_pair(1, COLOR_GREEN, COLOR_BLACK);                
+        wattron(winWindow, COLOR_PAIR(1));
+    }    
+    mvwprintw(winWindow, 1, 3, "CONGRATULATIONS, YOU WON!"); 
+    if (has_colors()) {                       
+        wattroff(winWindow, COLOR_PAIR(1));
+    }    
 
-    for(int i = x; i < x + 3; i++) {
-        for(int j = y; j < y + 3; j++) {
-            if(g.board[i][j] == num) {
-                return 1;
-            }
-        }        
-    }
+    mvwprintw(winWindow, 2, 5, "Press 'N', 'R' or 'Q'");      
+    wnoutrefresh(winWindow);    
+      
+    curs_set(0);
 
-    return 0;
-}
\ No newline at end of file
+}